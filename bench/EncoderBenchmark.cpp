@@ -0,0 +1,107 @@
+//
+//  EncoderBenchmark.cpp
+//
+//  Drives the OSC packet encoder the way MetaOSCThread::run() does and
+//  counts heap allocations per tick. Steady state must report zero.
+//
+//  Build with -DMETAOSC_BUILD_BENCHMARKS=ON, then run:
+//      ./MetaOSCEncoderBenchmark [sensors] [ticks]
+//
+
+#include "OscPacketEncoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// ---------------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+    const int sensors = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int ticks   = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+    osc::OscPacketEncoder encoder;
+    osc::OscPacketBuilder builder;
+    encoder.prepare(sensors);
+
+    // One sample of every stream per sensor.
+    SensorSample frame[kNumSensorStreams];
+    for (int s = 0; s < kNumSensorStreams; ++s) {
+        frame[s].stream    = static_cast<SensorStream>(s);
+        frame[s].numValues = static_cast<uint8_t>(streamValueCount(frame[s].stream));
+    }
+
+    size_t bytes = 0;
+    auto tick = [&](int t) {
+        for (auto& sample : frame) {
+            sample.epoch = 1700000000000LL + t * 10;
+            for (int v = 0; v < sample.numValues; ++v)
+                sample.values[v] = static_cast<float>(t + v);
+        }
+
+        // Per-message mode.
+        for (int i = 0; i < sensors; ++i)
+            for (const auto& sample : frame)
+                bytes += encoder.encode(i, sample).size();
+
+        // Whole-rig bundle mode, split into datagrams as the streaming loop
+        // does once a sensor's bundle would no longer fit.
+        const size_t needed = osc::OscPacketBuilder::kElementPrefixSize + osc::OscPacketBuilder::kBundleHeaderSize
+                            + kNumSensorStreams * osc::OscPacketEncoder::kMaxSampleSize;
+        size_t timeTagOffset = 0;
+        int64_t epoch = 0;
+        builder.reset();
+        for (int i = 0; i < sensors; ++i) {
+            if (!builder.empty() && builder.remaining() < needed) {
+                builder.endBundle();
+                builder.setTimeTag(timeTagOffset, osc::timeTagFromEpochMs(epoch));
+                bytes += builder.size();
+                builder.reset();
+            }
+            if (builder.empty())
+                timeTagOffset = builder.beginBundle(0);
+            epoch = encoder.appendSensorBundle(builder, i, frame, kNumSensorStreams);
+        }
+        builder.endBundle();
+        builder.setTimeTag(timeTagOffset, osc::timeTagFromEpochMs(epoch));
+        bytes += builder.size();
+    };
+
+    // Warm up, then measure.
+    tick(0);
+    const size_t allocationsBefore = g_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (int t = 1; t <= ticks; ++t)
+        tick(t);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const size_t allocations = g_allocations.load() - allocationsBefore;
+
+    const double ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    std::printf("sensors: %d  ticks: %d  bytes: %zu\n", sensors, ticks, bytes);
+    std::printf("time per tick: %.1f ns\n", ns / ticks);
+    std::printf("heap allocations per tick: %.3f (%zu total)\n",
+                static_cast<double>(allocations) / ticks, allocations);
+
+    return allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+//
+//  ShmBenchmark.cpp
+//
+//  Publishes sensor-sized batches into the shared-memory ring the way
+//  MetaOSCThread::run() does, with a separate reader process, and reports
+//  the reader's cost per record and its wake-up latency after a commit.
+//
+//  Build with -DMETAOSC_BUILD_BENCHMARKS=ON, then run:
+//      ./MetaOSCShmBenchmark [sensors] [passes]
+//
+
+#include "metaosc_shm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const kName = "/metaosc-bench";
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reader process: waits for commits, reads every record and measures.
+int runReader(int expected) {
+    metaosc_shm shm;
+    while (metaosc_shm_open(&shm, kName) != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<metaosc_shm_record> records(1024);
+    std::vector<int64_t> wakeNs;
+    int64_t readNs = 0;
+    long    total  = 0;
+    for (;;) {
+        const int ready = metaosc_shm_wait(&shm, 1000);
+        if (ready < 0)
+            break;
+        if (ready == 0)
+            continue;
+        const int64_t woke = nowNs();
+        const int n = metaosc_shm_read(&shm, records.data(), static_cast<int>(records.size()));
+        readNs += nowNs() - woke;
+        if (n <= 0)
+            continue;
+        wakeNs.push_back(woke - records[static_cast<size_t>(n - 1)].host_ns);
+        total += n;
+    }
+
+    std::sort(wakeNs.begin(), wakeNs.end());
+    auto pct = [&](double p) { return wakeNs.empty() ? 0.0 : wakeNs[static_cast<size_t>(p * (wakeNs.size() - 1))] / 1000.0; };
+    std::printf("reader: %ld of %d records, %llu lost, %.1f ns per record read\n",
+                total, expected, (unsigned long long)metaosc_shm_lost(&shm),
+                total ? static_cast<double>(readNs) / total : 0.0);
+    std::printf("reader: commit -> reader awake p50 %.1f us, p99 %.1f us\n", pct(0.5), pct(0.99));
+    metaosc_shm_close(&shm);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int sensors = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int passes  = argc > 2 ? std::atoi(argv[2]) : 20000;
+    const int perPass = sensors * 4;   // one fusion cycle: Euler, acc, gyro, mag
+
+    metaosc_shm shm;
+    if (metaosc_shm_create(&shm, kName, 65536, static_cast<uint32_t>(sensors)) != 0) {
+        std::perror("metaosc_shm_create");
+        return 1;
+    }
+
+    const pid_t reader = fork();
+    if (reader == 0)
+        return runReader(passes * perPass);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));   // let the reader map the ring
+
+    metaosc_shm_record record{};
+    record.num_values = 4;
+    int64_t writeNs = 0;
+    for (int p = 0; p < passes; ++p) {
+        const int64_t begin = nowNs();
+        for (int i = 0; i < perPass; ++i) {
+            record.epoch_ms = 1700000000000LL + p * 10;
+            record.host_ns  = nowNs();
+            record.sensor   = static_cast<uint32_t>(i / 4);
+            record.stream   = static_cast<uint8_t>(i % 4);
+            record.sequence = static_cast<uint64_t>(p);
+            metaosc_shm_write(&shm, &record);
+        }
+        metaosc_shm_commit(&shm);
+        writeNs += nowNs() - begin;
+        std::this_thread::sleep_for(std::chrono::microseconds(500));   // pacing like BLE wake-ups
+    }
+
+    std::printf("publisher: %d passes of %d records, %.1f ns per record written (incl. commit)\n",
+                passes, perPass, static_cast<double>(writeNs) / (static_cast<double>(passes) * perPass));
+    metaosc_shm_destroy(&shm);
+
+    int status = 0;
+    waitpid(reader, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,294 @@
+/*
+ *  metaosc_shm.c
+ *
+ *  Shared-memory sample ring: publisher and reader sides.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "metaosc_shm.h"
+
+#if METAOSC_SHM_SUPPORTED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+_Static_assert(sizeof(metaosc_shm_record) == 64, "records must stay one cache line");
+_Static_assert(sizeof(metaosc_shm_header) == 128, "header layout is part of the ABI");
+
+/* Record payload after the stamp, copied as relaxed atomic words so that a
+   read racing with the publisher is well defined (and then discarded). */
+#define PAYLOAD_WORDS ((sizeof(metaosc_shm_record) - sizeof(uint64_t)) / sizeof(uint64_t))
+
+static uint64_t* record_words(metaosc_shm_record* r) { return (uint64_t*)(void*)r; }
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* --- Wake-up ------------------------------------------------------------- */
+
+/* Sleeps while `*word == expected`, at most `timeout_ms` (-1 = forever).
+   Without futexes this is a short sleep; callers re-check either way. */
+static void wait_on(uint32_t* word, uint32_t expected, int timeout_ms) {
+#ifdef __linux__
+    struct timespec ts, *timeout = NULL;
+    if (timeout_ms >= 0) {
+        ts.tv_sec  = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+        timeout = &ts;
+    }
+    /* Not FUTEX_PRIVATE: the word is shared between processes. */
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout, NULL, 0);
+#else
+    struct timespec ts = { 0, 200000 };   /* 200 us */
+    (void)word;
+    (void)expected;
+    if (timeout_ms >= 0 && timeout_ms < 1)
+        return;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void wake_all(uint32_t* word) {
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+static int map_segment(metaosc_shm* shm, int fd, size_t size, int prot) {
+    void* base = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+    shm->header   = (metaosc_shm_header*)base;
+    shm->records  = (metaosc_shm_record*)((char*)base + sizeof(metaosc_shm_header));
+    shm->map_size = size;
+    return 0;
+}
+
+static void copy_name(metaosc_shm* shm, const char* name) {
+    strncpy(shm->name, name, sizeof shm->name - 1);
+    shm->name[sizeof shm->name - 1] = '\0';
+}
+
+/* --- Consumers ----------------------------------------------------------- */
+
+int metaosc_shm_open(metaosc_shm* shm, const char* name) {
+    struct stat st;
+    const metaosc_shm_header* h;
+    int fd;
+
+    memset(shm, 0, sizeof *shm);
+    /* Read-write: waiting readers register in `waiters`. */
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(metaosc_shm_header)) {
+        close(fd);
+        errno = EAGAIN;   /* still being created */
+        return -1;
+    }
+    if (map_segment(shm, fd, (size_t)st.st_size, PROT_READ | PROT_WRITE) != 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    h = shm->header;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != METAOSC_SHM_MAGIC) {
+        metaosc_shm_close(shm);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (h->version != METAOSC_SHM_VERSION || h->record_size != sizeof(metaosc_shm_record)
+        || h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0
+        || shm->map_size < sizeof(metaosc_shm_header) + (size_t)h->capacity * sizeof(metaosc_shm_record)) {
+        metaosc_shm_close(shm);
+        errno = EPROTO;
+        return -1;
+    }
+
+    shm->mask   = h->capacity - 1;
+    shm->cursor = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    copy_name(shm, name);
+    return 0;
+}
+
+int metaosc_shm_read(metaosc_shm* shm, metaosc_shm_record* out, int max) {
+    metaosc_shm_header* h = shm->header;
+    const uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    const uint64_t capacity = shm->mask + 1;
+    int n = 0;
+
+    if (head - shm->cursor > capacity) {
+        shm->lost  += head - shm->cursor - capacity;
+        shm->cursor = head - capacity;
+    }
+
+    while (n < max && shm->cursor < head) {
+        metaosc_shm_record* slot = &shm->records[shm->cursor & shm->mask];
+        const uint64_t expected = 2 * (shm->cursor + 1);
+        uint64_t* src = record_words(slot);
+        uint64_t* dst = record_words(&out[n]);
+        size_t k;
+
+        /* Seqlock read: the stamp must be this position's, before and after. */
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) != expected) {
+            ++shm->lost;   /* already overwritten by a later lap */
+            ++shm->cursor;
+            continue;
+        }
+        for (k = 1; k <= PAYLOAD_WORDS; ++k)
+            dst[k] = __atomic_load_n(&src[k], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_RELAXED) != expected) {
+            ++shm->lost;
+            ++shm->cursor;
+            continue;
+        }
+        dst[0] = expected;
+        ++n;
+        ++shm->cursor;
+    }
+
+    if (n == 0 && __atomic_load_n(&h->closed, __ATOMIC_ACQUIRE))
+        return -1;
+    return n;
+}
+
+int metaosc_shm_wait(metaosc_shm* shm, int timeout_ms) {
+    metaosc_shm_header* h = shm->header;
+    const int64_t deadline = timeout_ms < 0 ? 0 : monotonic_ns() + (int64_t)timeout_ms * 1000000;
+
+    for (;;) {
+        const uint32_t wake = __atomic_load_n(&h->wake, __ATOMIC_SEQ_CST);
+        int remaining_ms = -1;
+
+        if (__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) != shm->cursor)
+            return 1;
+        if (__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE))
+            return -1;
+        if (timeout_ms >= 0) {
+            const int64_t left = deadline - monotonic_ns();
+            if (left <= 0)
+                return 0;
+            remaining_ms = (int)((left + 999999) / 1000000);
+        }
+
+        /* Register before the final check: a commit either sees the waiter
+           and wakes it, or bumps `wake` first so the futex returns at once. */
+        __atomic_fetch_add(&h->waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) == shm->cursor)
+            wait_on(&h->wake, wake, remaining_ms);
+        __atomic_fetch_sub(&h->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+uint64_t metaosc_shm_lost(const metaosc_shm* shm) {
+    return shm->lost;
+}
+
+void metaosc_shm_close(metaosc_shm* shm) {
+    if (shm->header)
+        munmap(shm->header, shm->map_size);
+    memset(shm, 0, sizeof *shm);
+}
+
+/* --- Publisher ----------------------------------------------------------- */
+
+int metaosc_shm_create(metaosc_shm* shm, const char* name, uint32_t capacity, uint32_t num_sensors) {
+    uint32_t rounded = 64;
+    size_t size;
+    int fd;
+
+    memset(shm, 0, sizeof *shm);
+    while (rounded < capacity && rounded < (1u << 30))
+        rounded <<= 1;
+    size = sizeof(metaosc_shm_header) + (size_t)rounded * sizeof(metaosc_shm_record);
+
+    /* A previous run that crashed leaves its object behind; readers still
+       mapping it see it closed only if it was shut down cleanly. */
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, (off_t)size) != 0 || map_segment(shm, fd, size, PROT_READ | PROT_WRITE) != 0) {
+        const int saved = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = saved;
+        return -1;
+    }
+    close(fd);
+
+    /* ftruncate zero-fills, so every stamp starts invalid. */
+    shm->header->version     = METAOSC_SHM_VERSION;
+    shm->header->record_size = sizeof(metaosc_shm_record);
+    shm->header->capacity    = rounded;
+    shm->header->num_sensors = num_sensors;
+    shm->header->generation  = (uint64_t)monotonic_ns() ^ ((uint64_t)getpid() << 32);
+    __atomic_store_n(&shm->header->magic, METAOSC_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    shm->mask  = rounded - 1;
+    shm->owner = 1;
+    copy_name(shm, name);
+    return 0;
+}
+
+void metaosc_shm_write(metaosc_shm* shm, const metaosc_shm_record* record) {
+    const uint64_t position = shm->cursor++;
+    metaosc_shm_record* slot = &shm->records[position & shm->mask];
+    const uint64_t* src = (const uint64_t*)(const void*)record;
+    uint64_t* dst = record_words(slot);
+    const uint64_t stamp = 2 * (position + 1);
+    size_t k;
+
+    /* Odd while the payload is being replaced. */
+    __atomic_store_n(&slot->stamp, stamp - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (k = 1; k <= PAYLOAD_WORDS; ++k)
+        __atomic_store_n(&dst[k], src[k], __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->stamp, stamp, __ATOMIC_RELEASE);
+}
+
+void metaosc_shm_commit(metaosc_shm* shm) {
+    metaosc_shm_header* h = shm->header;
+    if (__atomic_load_n(&h->head, __ATOMIC_RELAXED) == shm->cursor)
+        return;
+    __atomic_store_n(&h->head, shm->cursor, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&h->wake, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->waiters, __ATOMIC_SEQ_CST) != 0)
+        wake_all(&h->wake);
+}
+
+void metaosc_shm_destroy(metaosc_shm* shm) {
+    if (!shm->header)
+        return;
+    if (shm->owner) {
+        metaosc_shm_commit(shm);
+        __atomic_store_n(&shm->header->closed, 1, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&shm->header->wake, 1, __ATOMIC_SEQ_CST);
+        wake_all(&shm->header->wake);
+        shm_unlink(shm->name);
+    }
+    metaosc_shm_close(shm);
+}
+
+#endif /* METAOSC_SHM_SUPPORTED */
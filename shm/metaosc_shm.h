@@ -0,0 +1,150 @@
+/*
+ *  metaosc_shm.h
+ *
+ *  Shared-memory output of MetaOSC: a single-producer / multi-consumer ring
+ *  of fixed 64-byte sample records in a POSIX shared-memory object, for
+ *  consumers on the same machine. Plain C; link metaosc_shm.c (or the
+ *  metaosc_shm static library) into the consumer.
+ *
+ *  Layout: a 128-byte metaosc_shm_header, then `capacity` records. The
+ *  publisher never waits for readers. Record i of the stream lives in slot
+ *  i % capacity and carries a sequence stamp, so a reader that falls more
+ *  than `capacity` records behind skips ahead and counts the loss instead
+ *  of reading torn data. `head` counts published records; `wake` is bumped
+ *  on every commit and is a futex word on Linux, so idle readers sleep in
+ *  the kernel rather than polling (elsewhere metaosc_shm_wait() polls).
+ *
+ *  Reading:
+ *      metaosc_shm shm;
+ *      if (metaosc_shm_open(&shm, "/metaosc") == 0) {
+ *          metaosc_shm_record records[256];
+ *          for (;;) {
+ *              if (metaosc_shm_wait(&shm, 100) < 0)
+ *                  break;                                  // MetaOSC exited
+ *              int n = metaosc_shm_read(&shm, records, 256);
+ *              for (int i = 0; i < n; ++i)
+ *                  use(records[i].sensor, records[i].stream, records[i].values);
+ *          }
+ *          metaosc_shm_close(&shm);
+ *      }
+ */
+
+#ifndef METAOSC_SHM_H
+#define METAOSC_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define METAOSC_SHM_SUPPORTED 1
+#else
+#define METAOSC_SHM_SUPPORTED 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METAOSC_SHM_MAGIC   0x4853434Fu   /* "OCSH" */
+#define METAOSC_SHM_VERSION 1u
+
+/* Stream of a record; the same order as MetaOSC's OSC stream table. */
+enum metaosc_stream {
+    METAOSC_STREAM_EULER  = 0,   /* heading/yaw, pitch, roll, yaw/heading (degrees) */
+    METAOSC_STREAM_ACC    = 1,   /* x, y, z (g) */
+    METAOSC_STREAM_GYRO   = 2,   /* x, y, z (deg/s) */
+    METAOSC_STREAM_MAG    = 3,   /* x, y, z (uT) */
+    METAOSC_STREAM_QUAT   = 4,   /* w, x, y, z */
+    METAOSC_STREAM_LINACC = 5    /* x, y, z (g) */
+};
+
+/* One sample; exactly one cache line. */
+typedef struct metaosc_shm_record {
+    uint64_t stamp;        /* internal: 2 * (position + 1) once complete */
+    int64_t  epoch_ms;     /* MetaWear sample time, ms since the Unix epoch */
+    int64_t  host_ns;      /* publisher's monotonic clock when published */
+    uint64_t sequence;     /* per-sensor sample counter */
+    uint32_t sensor;       /* sensor index, as in the OSC addresses */
+    uint8_t  stream;       /* enum metaosc_stream */
+    uint8_t  num_values;
+    uint16_t reserved0;
+    float    values[4];
+    uint64_t reserved1;
+} metaosc_shm_record;
+
+typedef struct metaosc_shm_header {
+    /* Written by the publisher before `magic`; constant afterwards. */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;      /* records; a power of two */
+    uint32_t num_sensors;
+    uint32_t closed;        /* set when the publisher exits */
+    uint64_t generation;    /* differs on every publisher start */
+    uint8_t  pad0[32];
+
+    /* Hot line: updated on every commit. */
+    uint64_t head;          /* records published so far */
+    uint32_t wake;          /* bumped on every commit (futex word) */
+    uint32_t waiters;       /* readers sleeping on `wake` */
+    uint8_t  pad1[48];
+} metaosc_shm_header;
+
+/* Handle for either side; treat the fields as private. */
+typedef struct metaosc_shm {
+    metaosc_shm_header* header;
+    metaosc_shm_record* records;
+    size_t              map_size;
+    uint64_t            mask;      /* capacity - 1 */
+    uint64_t            cursor;    /* reader: next position; publisher: next slot to write */
+    uint64_t            lost;      /* reader: records overwritten before they were read */
+    int                 owner;     /* publisher handle */
+    char                name[64];
+} metaosc_shm;
+
+#if METAOSC_SHM_SUPPORTED
+
+/* --- Consumers ---------------------------------------------------------- */
+
+/* Maps the ring published under `name` (e.g. "/metaosc"). Reading starts
+   at the newest record. Returns 0, or -1 with errno set. */
+int metaosc_shm_open(metaosc_shm* shm, const char* name);
+
+/* Copies up to `max` unread records into `out`, oldest first. Returns the
+   number copied, or -1 once the publisher has exited and nothing is left. */
+int metaosc_shm_read(metaosc_shm* shm, metaosc_shm_record* out, int max);
+
+/* Waits up to `timeout_ms` (-1 = forever) for unread records. Returns 1 if
+   there are some, 0 on timeout, -1 if the publisher has exited. */
+int metaosc_shm_wait(metaosc_shm* shm, int timeout_ms);
+
+/* Records skipped so far because the reader fell a whole ring behind. */
+uint64_t metaosc_shm_lost(const metaosc_shm* shm);
+
+void metaosc_shm_close(metaosc_shm* shm);
+
+/* --- Publisher (MetaOSC) ------------------------------------------------ */
+
+/* Creates (replacing any stale one) and maps the ring. `capacity` is
+   rounded up to a power of two. Returns 0, or -1 with errno set. */
+int metaosc_shm_create(metaosc_shm* shm, const char* name, uint32_t capacity, uint32_t num_sensors);
+
+/* Writes one record; readers see it after the next commit. `record->stamp`
+   is ignored. */
+void metaosc_shm_write(metaosc_shm* shm, const metaosc_shm_record* record);
+
+/* Publishes every record written since the last commit and wakes waiting
+   readers. */
+void metaosc_shm_commit(metaosc_shm* shm);
+
+/* Marks the ring closed, wakes readers and removes the name. Readers keep
+   their mapping until they close it. */
+void metaosc_shm_destroy(metaosc_shm* shm);
+
+#endif /* METAOSC_SHM_SUPPORTED */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METAOSC_SHM_H */
@@ -1,7 +1,18 @@
+#pragma once
+
 #include "simpleble/SimpleBLE.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 // BLE UUIDs for Nordic UART Service (used by MetaWear for BLE communication)
@@ -19,14 +30,29 @@
 #define METAMOTION_WRITE_SERVICE_UUID   "326a9000-85cb-9195-d9dd-464cfbbae75a"
 #define METAMOTION_WRITE_UUID           "326a9001-85cb-9195-d9dd-464cfbbae75a"
 
-// Wraps SimpleBLE adapter/peripheral management: scans for devices and
-// filters results for MetaWear peripherals.
+// Wraps SimpleBLE adapter/peripheral management: scans for devices on every
+// BLE adapter and assigns each MetaWear peripheral to one of them.
+//
+// A SimpleBLE peripheral connects through the adapter that discovered it,
+// so all adapters scan at once and every sighting is kept. Each sensor is
+// then assigned to the adapter with the fewest sensors so far that saw it
+// (ties go to the stronger signal), spreading a large rig over several
+// USB dongles. Scan callbacks run on each adapter's own thread;
+// BleInterface serialises them internally.
 class BleInterface {
 public:
+    // One peripheral as seen by one adapter.
+    struct Sighting {
+        size_t                adapter = 0;
+        SimpleBLE::Peripheral peripheral;
+        int16_t               rssi = 0;
+    };
+
     std::vector<SimpleBLE::Peripheral> peripherals;
     std::vector<SimpleBLE::Adapter> adapters;
+    std::vector<size_t> adapterLoad;   // sensors assigned per adapter
 
-    // Initialise the BLE adapter and scan for devices.
+    // Initialise the BLE adapters and scan for devices.
     void setup() {
         scanDevices();
     }
@@ -36,31 +62,191 @@ public:
         adapter.scan_stop();
     }
 
-    // Fetch all BLE adapters, then perform a timed scan and populate `peripherals`.
-    void scanDevices() {
-        adapters = SimpleBLE::Adapter::get_adapters();
-
+    // Fetch all BLE adapters once. Returns false if there are none.
+    bool openAdapters() {
         if (adapters.empty()) {
+            adapters = SimpleBLE::Adapter::get_adapters();
+            adapterLoad.assign(adapters.size(), 0);
+            for (size_t i = 0; i < adapters.size(); ++i)
+                std::cout << "BLE adapter " << i << ": " << adapters[i].identifier()
+                          << " [" << adapters[i].address() << "]" << std::endl;
+        }
+        if (adapters.empty())
             std::cout << "No BLE adapter found." << std::endl;
+        return !adapters.empty();
+    }
+
+    // Timed scan on every adapter; populates `peripherals` and the sightings
+    // used by getMetaMotionPeripherals().
+    void scanDevices() {
+        if (!openAdapters())
             return;
+
+        for (size_t a = 0; a < adapters.size(); ++a) {
+            SimpleBLE::Adapter& adapter = adapters[a];
+            adapter.set_callback_on_scan_start([a]() {
+                std::cout << "Scan started on adapter " << a << "." << std::endl;
+            });
+            adapter.set_callback_on_scan_stop([a]() {
+                std::cout << "Scan stopped on adapter " << a << "." << std::endl;
+            });
+            adapter.set_callback_on_scan_found([this, a](SimpleBLE::Peripheral peripheral) {
+                std::lock_guard<std::mutex> lock(scanMutex);
+                std::cout << "Found device: " << peripheral.identifier()
+                          << " [" << peripheral.address() << "] "
+                          << peripheral.rssi() << " dBm (adapter " << a << ")" << std::endl;
+                peripherals.push_back(peripheral);
+                sightings.push_back({ a, peripheral, peripheral.rssi() });
+            });
+        }
+
+        for (auto& adapter : adapters)
+            adapter.scan_start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(SCAN_TIMEOUT_MS));
+        for (auto& adapter : adapters)
+            adapter.scan_stop();
+    }
+
+    // Upper-cases an address/identifier so config entries match regardless
+    // of how the platform formats them.
+    static std::string normaliseAddress(std::string address) {
+        std::transform(address.begin(), address.end(), address.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        return address;
+    }
+
+    // `addresses` normalised, in order, with repeats left out (and logged).
+    static std::vector<std::string> uniqueAddresses(const std::vector<std::string>& addresses) {
+        std::vector<std::string> unique;
+        for (const auto& address : addresses) {
+            auto normalised = normaliseAddress(address);
+            if (std::find(unique.begin(), unique.end(), normalised) != unique.end())
+                std::cout << "Address " << address << " is listed more than once, ignoring the repeat." << std::endl;
+            else
+                unique.push_back(std::move(normalised));
+        }
+        return unique;
+    }
+
+    // Scan on every adapter until each address in `targets` has been seen,
+    // or until `timeoutMs` elapses, then stop scanning. Found peripherals
+    // are matched by hash lookup and `onAssigned(targetIndex, sighting)`
+    // fires once per found target with the adapter it was assigned to.
+    //
+    // With `assignEarly`, a target is assigned the moment an adapter below
+    // its fair share (targets / adapters) sees it, so callers can start
+    // connecting during the scan; otherwise, and for targets only seen by
+    // full adapters, assignment waits for the scan to end and uses every
+    // sighting. Callbacks are serialised. A repeated address only counts
+    // once, under its first index. Returns the number of targets found.
+    size_t scanForTargets(const std::vector<std::string>& targets, int timeoutMs, bool assignEarly,
+                          std::function<void(size_t, const Sighting&)> onAssigned) {
+        if (!openAdapters())
+            return 0;
+
+        // Shared with the scan callbacks, which SimpleBLE may still be
+        // running (blocked on scanMutex) after this function has returned.
+        struct ScanState {
+            std::unordered_map<std::string, size_t> lookup;   // normalised address -> target index
+            std::vector<std::vector<Sighting>>      seen;     // per target
+            std::vector<bool>                       assigned;
+            size_t                                  wanted    = 0;
+            size_t                                  fairShare = 0;
+            size_t                                  numSeen   = 0;
+            std::condition_variable                 allFound;
+            bool                                    scanning  = true;
+        };
+        auto state = std::make_shared<ScanState>();
+        std::vector<bool> repeated(targets.size(), false);
+        for (size_t i = 0; i < targets.size(); ++i)
+            repeated[i] = !state->lookup.emplace(normaliseAddress(targets[i]), i).second;
+        state->seen.resize(targets.size());
+        state->assigned.assign(targets.size(), false);
+        state->wanted    = state->lookup.size();
+        state->fairShare = (state->wanted + adapters.size() - 1) / adapters.size();
+
+        // Called with scanMutex held.
+        auto assign = [this, state, onAssigned](size_t index, const Sighting& s) {
+            state->assigned[index] = true;
+            ++adapterLoad[s.adapter];
+            peripherals.push_back(s.peripheral);
+            if (onAssigned)
+                onAssigned(index, s);
+        };
+
+        for (size_t a = 0; a < adapters.size(); ++a) {
+            SimpleBLE::Adapter& adapter = adapters[a];
+            adapter.set_callback_on_scan_start([a]() {
+                std::cout << "Scan started on adapter " << a << "." << std::endl;
+            });
+            adapter.set_callback_on_scan_stop([a]() {
+                std::cout << "Scan stopped on adapter " << a << "." << std::endl;
+            });
+            adapter.set_callback_on_scan_found([this, state, assign, assignEarly, a](SimpleBLE::Peripheral peripheral) {
+                std::lock_guard<std::mutex> lock(scanMutex);
+                if (!state->scanning) return;
+
+                auto it = state->lookup.find(normaliseAddress(peripheral.address()));
+                if (it == state->lookup.end())
+                    it = state->lookup.find(normaliseAddress(peripheral.identifier()));
+                if (it == state->lookup.end())
+                    return;
+
+                const size_t index = it->second;
+                auto& targetSightings = state->seen[index];
+                for (const auto& s : targetSightings)
+                    if (s.adapter == a)
+                        return;   // already seen by this adapter
+
+                const Sighting sighting{ a, peripheral, peripheral.rssi() };
+                targetSightings.push_back(sighting);
+                std::cout << "Found target: " << peripheral.identifier()
+                          << " [" << peripheral.address() << "] "
+                          << sighting.rssi << " dBm (adapter " << a << ")" << std::endl;
+
+                if (assignEarly && !state->assigned[index] && adapterLoad[a] < state->fairShare)
+                    assign(index, sighting);
+                if (targetSightings.size() == 1 && ++state->numSeen == state->wanted)
+                    state->allFound.notify_one();
+            });
+        }
+
+        for (auto& adapter : adapters)
+            adapter.scan_start();
+        {
+            std::unique_lock<std::mutex> lock(scanMutex);
+            state->allFound.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                     [&] { return state->numSeen == state->wanted; });
+            state->scanning = false;
         }
+        for (auto& adapter : adapters) {
+            adapter.scan_stop();
+            adapter.set_callback_on_scan_found([](SimpleBLE::Peripheral) {});
+        }
+
+        std::lock_guard<std::mutex> lock(scanMutex);
+        size_t found = 0;
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (repeated[i])
+                continue;
+            const auto& targetSightings = state->seen[i];
+            if (targetSightings.empty()) {
+                std::cout << "Target not found: " << targets[i] << std::endl;
+                continue;
+            }
+            ++found;
+            if (!state->assigned[i])
+                assign(i, targetSightings[pickAdapter(targetSightings)]);
+        }
+        logAdapterLoad();
+        return found;
+    }
 
-        SimpleBLE::Adapter& adapter = adapters[0];
-
-        adapter.set_callback_on_scan_start([]() {
-            std::cout << "Scan started." << std::endl;
-        });
-        adapter.set_callback_on_scan_stop([]() {
-            std::cout << "Scan stopped." << std::endl;
-        });
-        adapter.set_callback_on_scan_found([this](SimpleBLE::Peripheral peripheral) {
-            std::cout << "Found device: " << peripheral.identifier()
-                      << " [" << peripheral.address() << "] "
-                      << peripheral.rssi() << " dBm" << std::endl;
-            peripherals.push_back(peripheral);
-        });
-
-        adapter.scan_for(SCAN_TIMEOUT_MS);
+    // A sensor on `adapter` went away; frees its place for load balancing.
+    void release(size_t adapter) {
+        std::lock_guard<std::mutex> lock(scanMutex);
+        if (adapter < adapterLoad.size() && adapterLoad[adapter] > 0)
+            --adapterLoad[adapter];
     }
 
     // Print all discovered peripherals to stdout.
@@ -72,15 +258,54 @@ public:
         }
     }
 
-    // Return only peripherals whose name contains "MetaWear".
-    std::vector<SimpleBLE::Peripheral> getMetaMotionPeripherals() {
-        std::vector<SimpleBLE::Peripheral> metaMotionPeripherals;
-        for (auto& p : peripherals) {
-            if (p.identifier().find("MetaWear") != std::string::npos) {
-                std::cout << "Auto found MetaMotion: " << p.address() << '\n';
-                metaMotionPeripherals.push_back(p);
-            }
+    // Return one sighting per peripheral whose name contains "MetaWear",
+    // each assigned to an adapter that saw it.
+    std::vector<Sighting> getMetaMotionPeripherals() {
+        std::lock_guard<std::mutex> lock(scanMutex);
+
+        std::vector<std::string>           order;   // first-seen order of addresses
+        std::unordered_map<std::string, std::vector<Sighting>> byAddress;
+        for (auto& s : sightings) {
+            if (s.peripheral.identifier().find("MetaWear") == std::string::npos)
+                continue;
+            const auto address = normaliseAddress(s.peripheral.address());
+            auto& list = byAddress[address];
+            if (list.empty())
+                order.push_back(address);
+            list.push_back(s);
         }
+
+        std::vector<Sighting> metaMotionPeripherals;
+        for (const auto& address : order) {
+            const auto& list = byAddress[address];
+            const Sighting& chosen = list[pickAdapter(list)];
+            ++adapterLoad[chosen.adapter];
+            std::cout << "Auto found MetaMotion: " << address << " (adapter " << chosen.adapter << ")\n";
+            metaMotionPeripherals.push_back(chosen);
+        }
+        logAdapterLoad();
         return metaMotionPeripherals;
     }
+
+private:
+    // Index of the sighting whose adapter has the fewest assigned sensors;
+    // ties go to the stronger signal.
+    size_t pickAdapter(const std::vector<Sighting>& candidates) const {
+        size_t best = 0;
+        for (size_t i = 1; i < candidates.size(); ++i) {
+            const size_t load     = adapterLoad[candidates[i].adapter];
+            const size_t bestLoad = adapterLoad[candidates[best].adapter];
+            if (load < bestLoad || (load == bestLoad && candidates[i].rssi > candidates[best].rssi))
+                best = i;
+        }
+        return best;
+    }
+
+    void logAdapterLoad() const {
+        for (size_t a = 0; a < adapters.size(); ++a)
+            std::cout << "Adapter " << a << ": " << adapterLoad[a] << " sensor(s)" << std::endl;
+    }
+
+    std::mutex            scanMutex;
+    std::vector<Sighting> sightings;   // scanDevices() results, one per adapter and peripheral
 };
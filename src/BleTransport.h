@@ -0,0 +1,75 @@
+#pragma once
+
+#include "simpleble/SimpleBLE.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Byte-level link between a MetaMotionController and one MetaWear board.
+//
+// The MetaWear SDK only needs GATT read, write-without-response and notify,
+// plus connect/disconnect. MetaMotionController talks to this interface so
+// the same controller can drive real hardware (SimpleBleTransport) or a
+// simulated board (SimulatedMetaWearTransport).
+class BleTransport {
+public:
+    using NotifyCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+    virtual ~BleTransport() = default;
+
+    virtual std::string address() = 0;
+    virtual void connect() = 0;
+    virtual void disconnect() = 0;
+    virtual bool isConnected() = 0;
+
+    virtual std::vector<uint8_t> read(const std::string& service,
+                                      const std::string& characteristic) = 0;
+    virtual void write(const std::string& service, const std::string& characteristic,
+                       const uint8_t* data, size_t size) = 0;
+    virtual void notify(const std::string& service, const std::string& characteristic,
+                        NotifyCallback callback) = 0;
+
+    // Called on the transport's thread when the link drops unexpectedly.
+    virtual void onDisconnected(std::function<void()> /*callback*/) {}
+};
+
+// Transport backed by a real SimpleBLE peripheral.
+class SimpleBleTransport : public BleTransport {
+public:
+    explicit SimpleBleTransport(SimpleBLE::Peripheral peripheralIn)
+        : peripheral(std::move(peripheralIn)) {}
+
+    std::string address() override { return peripheral.address(); }
+    void connect() override        { peripheral.connect(); }
+    void disconnect() override     { peripheral.disconnect(); }
+    bool isConnected() override    { return peripheral.is_connected(); }
+
+    std::vector<uint8_t> read(const std::string& service,
+                              const std::string& characteristic) override {
+        auto data = peripheral.read(service, characteristic);
+        auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+        return std::vector<uint8_t>(bytes, bytes + data.size());
+    }
+
+    void write(const std::string& service, const std::string& characteristic,
+               const uint8_t* data, size_t size) override {
+        peripheral.write_command(service, characteristic, SimpleBLE::ByteArray(data, size));
+    }
+
+    void notify(const std::string& service, const std::string& characteristic,
+                NotifyCallback callback) override {
+        // Take the payload by reference so every notification is not copied again.
+        peripheral.notify(service, characteristic,
+            [callback = std::move(callback)](const SimpleBLE::ByteArray& payload) {
+                callback(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+            });
+    }
+
+    void onDisconnected(std::function<void()> callback) override {
+        peripheral.set_callback_on_disconnected(std::move(callback));
+    }
+
+    SimpleBLE::Peripheral peripheral;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded pool of worker threads used to connect and initialise sensors.
+// Jobs may be submitted from any thread (e.g. a BLE scan callback) while the
+// pool is running; finish() waits until every submitted job has completed.
+class ConnectionPool {
+public:
+    explicit ConnectionPool(int numWorkers) {
+        for (int i = 0; i < std::max(1, numWorkers); ++i)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ConnectionPool() { finish(); }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    // Runs all queued jobs to completion and joins the workers.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        jobAvailable.notify_all();
+        for (auto& worker : workers)
+            if (worker.joinable())
+                worker.join();
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return closing || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread>          workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex                        mutex;
+    std::condition_variable           jobAvailable;
+    bool                              closing = false;
+};
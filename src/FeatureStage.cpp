@@ -0,0 +1,222 @@
+//
+//  FeatureStage.cpp
+//
+//  Incremental sliding-window RMS, peak, zero-crossing rate, tilt and
+//  stillness per sensor.
+//
+
+#include "FeatureStage.h"
+#include "LatencyTracer.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+constexpr double kRadToDeg  = 57.29577951308232;
+constexpr double kMaxRateHz = 1600.0;   // fastest raw IMU rate; sizes the rings
+
+} // namespace
+
+bool FeatureStage::configure(const nlohmann::json& features, int numSensorsIn) {
+    numSensors = 0;
+    sensors.clear();
+    if (numSensorsIn == 0)
+        return false;
+
+    const double rateHz = std::max(1.0, features.value("rate_hz", 30.0));
+    windowMs   = std::max<int64_t>(10, features.value("window_ms", static_cast<int64_t>(1000)));
+    tickNs     = static_cast<int64_t>(1e9 / rateHz);
+    nextTickNs = latency::nowNs() + tickNs;
+
+    if (features.contains("zcr_hysteresis")) {
+        const auto& h = features["zcr_hysteresis"];
+        accHysteresis  = h.value("acc", accHysteresis);
+        gyroHysteresis = h.value("gyro", gyroHysteresis);
+    }
+    if (features.contains("still")) {
+        const auto& still = features["still"];
+        stillAcc   = still.value("acc", stillAcc);
+        stillGyro  = still.value("gyro", stillGyro);
+        stillMinNs = still.value("min_ms", stillMinNs / 1000000) * 1000000;
+    }
+
+    // Every sample in the window must fit, at the fastest rate a board sends.
+    const size_t capacity = static_cast<size_t>(static_cast<double>(windowMs) * kMaxRateHz / 1000.0) + 16;
+
+    static const char* const names[kMessagesPerSensor]  = { "rms", "peak", "zcr", "tilt", "still" };
+    static const int         widths[kMessagesPerSensor] = { 2, 2, 2, 3, 2 };
+
+    numSensors = numSensorsIn;
+    sensors.resize(static_cast<size_t>(numSensors));
+    char address[48];
+    for (int i = 0; i < numSensors; ++i) {
+        auto& sensor = sensors[static_cast<size_t>(i)];
+        sensor.acc.prepare(capacity);
+        sensor.gyro.prepare(capacity);
+        for (int m = 0; m < kMessagesPerSensor; ++m) {
+            std::snprintf(address, sizeof address, "/feat/%d/%s", i, names[m]);
+            sensor.messages[m].build(address, widths[m]);
+        }
+    }
+    return true;
+}
+
+int FeatureStage::waitMs(int64_t nowNs) const {
+    const int64_t remaining = (nextTickNs - nowNs + 999999) / 1000000;
+    return static_cast<int>(std::clamp<int64_t>(remaining, 1, 100));
+}
+
+void FeatureStage::push(int sensor, const SensorSample& sample) {
+    auto& s = sensors[static_cast<size_t>(sensor)];
+    Window* window;
+    if (sample.stream == SensorStream::Acc) {
+        window = &s.acc;
+        window->push(sample.epoch, sample.values, windowMs, accHysteresis);
+    } else if (sample.stream == SensorStream::Gyro) {
+        window = &s.gyro;
+        window->push(sample.epoch, sample.values, windowMs, gyroHysteresis);
+    } else {
+        return;
+    }
+    window->lastSampleNs = latency::nowNs();
+}
+
+// ---------------------------------------------------------------------------
+// Window
+// ---------------------------------------------------------------------------
+
+void FeatureStage::Window::prepare(size_t capacity) {
+    ring.assign(capacity, {});
+    maxQueue.assign(capacity, 0);
+}
+
+void FeatureStage::Window::popFront() {
+    const Entry& e = ring[head];
+    for (int k = 0; k < 3; ++k) {
+        sum[k]   -= e.v[k];
+        sumSq[k] -= static_cast<double>(e.v[k]) * e.v[k];
+    }
+    magnitudeSum -= e.magnitude;
+    crossings    -= e.crossing ? 1 : 0;
+    if (maxCount > 0 && maxQueue[maxHead] == pushed - count) {
+        maxHead = (maxHead + 1) % maxQueue.size();
+        --maxCount;
+    }
+    head = (head + 1) % ring.size();
+    if (--count == 0) {
+        // Start the next run of sums from exact zeros.
+        std::fill(std::begin(sum), std::end(sum), 0.0);
+        std::fill(std::begin(sumSq), std::end(sumSq), 0.0);
+        magnitudeSum = 0.0;
+        crossings    = 0;
+        side         = 0;
+    }
+}
+
+void FeatureStage::Window::push(int64_t epoch, const float* v, int64_t windowLengthMs, float hysteresis) {
+    // A board whose clock was re-anchored (e.g. after a reconnect) starts a
+    // fresh window rather than keeping samples from the future.
+    if (count > 0 && epoch < at(count - 1).epoch - windowLengthMs)
+        clear();
+    while (count > 0 && (count == ring.size() || at(0).epoch <= epoch - windowLengthMs))
+        popFront();
+
+    Entry e;
+    e.epoch = epoch;
+    double magnitudeSq = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        e.v[k] = v[k];
+        magnitudeSq += static_cast<double>(v[k]) * v[k];
+    }
+    e.magnitude = static_cast<float>(std::sqrt(magnitudeSq));
+
+    // Crossing of the magnitude through its window mean, with hysteresis so
+    // that sensor noise around the mean is not counted.
+    if (count > 0) {
+        const double deviation = e.magnitude - magnitudeSum / static_cast<double>(count);
+        if (deviation > hysteresis) {
+            e.crossing = side < 0;
+            side = 1;
+        } else if (deviation < -hysteresis) {
+            e.crossing = side > 0;
+            side = -1;
+        }
+    }
+
+    // Monotonic queue: drop queued samples this one outlasts and outweighs.
+    while (maxCount > 0
+           && ring[maxQueue[(maxHead + maxCount - 1) % maxQueue.size()] % ring.size()].magnitude <= e.magnitude)
+        --maxCount;
+    maxQueue[(maxHead + maxCount) % maxQueue.size()] = pushed;
+    ++maxCount;
+
+    ring[(head + count) % ring.size()] = e;
+    ++count;
+    ++pushed;
+    for (int k = 0; k < 3; ++k) {
+        sum[k]   += e.v[k];
+        sumSq[k] += static_cast<double>(e.v[k]) * e.v[k];
+    }
+    magnitudeSum += e.magnitude;
+    crossings    += e.crossing ? 1 : 0;
+}
+
+double FeatureStage::Window::spanSeconds() const {
+    return count < 2 ? 0.0 : static_cast<double>(at(count - 1).epoch - at(0).epoch) * 1e-3;
+}
+
+// ---------------------------------------------------------------------------
+// Per report
+// ---------------------------------------------------------------------------
+
+void FeatureStage::evaluate(Sensor& sensor, int64_t nowNs) {
+    const Window& acc  = sensor.acc;
+    const Window& gyro = sensor.gyro;
+    float (&out)[kMessagesPerSensor][4] = sensor.values;
+
+    // O(1): everything below reads the running sums.
+    double accRms = 0.0, gyroRms = 0.0;
+    if (acc.count > 0)
+        for (int k = 0; k < 3; ++k) {
+            const double mean = acc.mean(k);
+            accRms += std::max(0.0, acc.sumSq[k] / static_cast<double>(acc.count) - mean * mean);
+        }
+    if (gyro.count > 0)
+        for (int k = 0; k < 3; ++k)
+            gyroRms += gyro.sumSq[k] / static_cast<double>(gyro.count);
+    accRms  = std::sqrt(accRms);
+    gyroRms = std::sqrt(gyroRms);
+
+    auto rate = [](const Window& w) {
+        const double span = w.spanSeconds();
+        return span > 0.0 ? static_cast<float>(w.crossings / span) : 0.0f;
+    };
+
+    out[Rms][0]  = static_cast<float>(accRms);
+    out[Rms][1]  = static_cast<float>(gyroRms);
+    out[Peak][0] = acc.count > 0 ? acc.peak() : 0.0f;
+    out[Peak][1] = gyro.count > 0 ? gyro.peak() : 0.0f;
+    out[Zcr][0]  = rate(acc);
+    out[Zcr][1]  = rate(gyro);
+
+    // Tilt from the averaged acceleration, i.e. the gravity direction.
+    if (acc.count > 0) {
+        const double x = acc.mean(0), y = acc.mean(1), z = acc.mean(2);
+        const double norm = std::sqrt(x * x + y * y + z * z);
+        out[Tilt][0] = static_cast<float>(std::atan2(-x, std::sqrt(y * y + z * z)) * kRadToDeg);
+        out[Tilt][1] = static_cast<float>(std::atan2(y, z) * kRadToDeg);
+        out[Tilt][2] = norm > 0.0 ? static_cast<float>(std::acos(std::clamp(z / norm, -1.0, 1.0)) * kRadToDeg) : 0.0f;
+    }
+
+    // Still once both streams have stayed below their thresholds for min_ms.
+    const bool quiet = (acc.count == 0 || accRms < stillAcc) && (gyro.count == 0 || gyroRms < stillGyro);
+    if (!quiet)
+        sensor.quietSinceNs = 0;
+    else if (sensor.quietSinceNs == 0)
+        sensor.quietSinceNs = nowNs;
+    const int64_t quietNs = sensor.quietSinceNs == 0 ? 0 : nowNs - sensor.quietSinceNs;
+    const bool still = sensor.quietSinceNs != 0 && quietNs >= stillMinNs;
+    out[Still][0] = still ? 1.0f : 0.0f;
+    out[Still][1] = still ? static_cast<float>(static_cast<double>(quietNs) * 1e-9) : 0.0f;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "FrameAligner.h"
+#include "OscPacketEncoder.h"
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Sliding-window motion features, computed incrementally.
+//
+// Every acc and gyro sample updates its sensor's window in O(1) (amortised):
+// the sample enters a ring buffer, whatever has fallen out of `window_ms`
+// leaves it, and running sums, a monotonic max queue and a crossing count
+// are adjusted by just those entries. Nothing is recomputed over the
+// window. At `rate_hz` the current values go out as one bundle of
+//     /feat/{index}/rms    acc gyro        acc about its window mean (g), gyro magnitude (deg/s)
+//     /feat/{index}/peak   acc gyro        window maximum of |acc| (g) and |gyro| (deg/s)
+//     /feat/{index}/zcr    acc gyro        crossings per second of each magnitude about its window mean
+//     /feat/{index}/tilt   pitch roll incl from the window-mean acc (degrees)
+//     /feat/{index}/still  flag seconds    1 while below both stillness thresholds, and for how long
+// for every sensor with data in the window. Values of a stream the board
+// does not send read 0, and tilt is left out without acc. Config "features"
+// enables the acc and gyro outputs on every board.
+//
+// config["features"]:
+//     "rate_hz": 30,                        publish rate
+//     "window_ms": 1000,                    window length
+//     "zcr_hysteresis": { "acc": 0.02, "gyro": 5 },
+//     "still": { "acc": 0.02, "gyro": 3, "min_ms": 300 }
+// ---------------------------------------------------------------------------
+
+class FeatureStage {
+public:
+    // Sizes every window from config["features"]. Returns false if there
+    // are no sensors.
+    bool configure(const nlohmann::json& features, int numSensors);
+
+    bool enabled() const { return numSensors > 0; }
+
+    // Streaming thread: adds a drained acc or gyro sample to its window.
+    void push(int sensor, const SensorSample& sample);
+
+    // Streaming thread: publishes the features into `sink` (osc::StageSink)
+    // if a report is due by `nowNs`.
+    template <typename Sink>
+    void tick(int64_t nowNs, Sink& sink) {
+        if (nowNs < nextTickNs)
+            return;
+        nextTickNs += tickNs;
+        if (nextTickNs <= nowNs)
+            nextTickNs = nowNs + tickNs;   // after a stall, skip rather than burst
+
+        constexpr uint32_t kAcc  = 1u << static_cast<int>(SensorStream::Acc);
+        constexpr uint32_t kGyro = 1u << static_cast<int>(SensorStream::Gyro);
+
+        sink.begin(osc::timeTagFromEpochMs(FrameAligner::hostToEpochMs(static_cast<double>(nowNs) * 1e-6)));
+        for (int i = 0; i < numSensors; ++i) {
+            auto& sensor = sensors[static_cast<size_t>(i)];
+            // A stream that stopped sending drops out once its window has
+            // passed, instead of repeating stale features.
+            for (Window* window : { &sensor.acc, &sensor.gyro })
+                if (window->count > 0 && nowNs - window->lastSampleNs > windowMs * 1000000)
+                    window->clear();
+            const bool hasAcc  = sensor.acc.count > 0;
+            const bool hasGyro = sensor.gyro.count > 0;
+            if (!hasAcc && !hasGyro) {
+                sensor.quietSinceNs = 0;
+                continue;
+            }
+            evaluate(sensor, nowNs);
+
+            for (int m = 0; m < kMessagesPerSensor; ++m) {
+                if (m == Tilt && !hasAcc)
+                    continue;
+                sensor.messages[m].setValues(sensor.values[m]);
+                sink.add(i, m == Tilt ? kAcc : kAcc | kGyro, sensor.messages[m]);
+            }
+        }
+        sink.end();
+    }
+
+    int waitMs(int64_t nowNs) const;
+
+private:
+    enum Message { Rms = 0, Peak, Zcr, Tilt, Still, kMessagesPerSensor };
+
+    // One stream of one sensor over the window.
+    struct Window {
+        struct Entry {
+            int64_t epoch = 0;
+            float   v[3]  = {};
+            float   magnitude = 0.0f;
+            bool    crossing  = false;
+        };
+
+        std::vector<Entry>    ring;
+        std::vector<uint64_t> maxQueue;   // sample numbers, magnitudes decreasing
+        size_t   head = 0, count = 0;     // ring: oldest entry, entries held
+        size_t   maxHead = 0, maxCount = 0;
+        uint64_t pushed = 0;              // sample number of the next entry
+        int64_t  lastSampleNs = 0;        // host time of the newest entry
+
+        // Running sums over the entries held (double, so that adding and
+        // removing millions of samples does not drift).
+        double sum[3]   = {};
+        double sumSq[3] = {};
+        double magnitudeSum = 0.0;
+        int    crossings    = 0;
+        int    side         = 0;   // Schmitt trigger state: -1 below, +1 above the mean
+
+        void   prepare(size_t capacity);
+        void   push(int64_t epoch, const float* v, int64_t windowMs, float hysteresis);
+        void   popFront();
+        void   clear() { while (count > 0) popFront(); }
+        const Entry& at(size_t k) const { return ring[(head + k) % ring.size()]; }
+        double mean(int axis) const { return sum[axis] / static_cast<double>(count); }
+        float  peak() const { return ring[maxQueue[maxHead] % ring.size()].magnitude; }
+        double spanSeconds() const;
+    };
+
+    struct Sensor {
+        Window  acc, gyro;
+        int64_t quietSinceNs = 0;   // below both stillness thresholds since (0 = moving)
+        float   values[kMessagesPerSensor][4] = {};
+        osc::OscMessageTemplate messages[kMessagesPerSensor];
+    };
+
+    void evaluate(Sensor& sensor, int64_t nowNs);
+
+    int     numSensors = 0;
+    int64_t windowMs   = 1000;
+    int64_t tickNs     = 0;
+    int64_t nextTickNs = 0;
+    float   accHysteresis  = 0.02f;
+    float   gyroHysteresis = 5.0f;
+    float   stillAcc       = 0.02f;
+    float   stillGyro      = 3.0f;
+    int64_t stillMinNs     = 300000000;
+
+    std::vector<Sensor> sensors;
+};
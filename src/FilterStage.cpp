@@ -0,0 +1,255 @@
+//
+//  FilterStage.cpp
+//
+//  Struct-of-arrays one-euro, biquad low-pass and derivative filters over
+//  every sensor of the rig.
+//
+
+#include "FilterStage.h"
+#include "LatencyTracer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+constexpr float kTwoPi = 6.28318530718f;
+
+// Smoothing factor of a first-order low-pass at `cutoffHz` for step `dt`.
+float smoothingAlpha(float cutoffHz, float dt) {
+    return 1.0f / (1.0f + 1.0f / (kTwoPi * cutoffHz * dt));
+}
+
+bool parseType(const std::string& name, FilterStage::Type& type) {
+    if      (name == "one_euro")    type = FilterStage::Type::OneEuro;
+    else if (name == "lowpass")     type = FilterStage::Type::LowPass;
+    else if (name == "derivative")  type = FilterStage::Type::Derivative;
+    else if (name == "derivative2") type = FilterStage::Type::Derivative2;
+    else if (name == "jerk")        type = FilterStage::Type::Jerk;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+bool FilterStage::configure(const nlohmann::json& filters, int numSensorsIn) {
+    banks.clear();
+    numSensors = numSensorsIn;
+    if (numSensors == 0 || !filters.contains("chains"))
+        return false;
+
+    const double rateHz = std::max(1.0, filters.value("rate_hz", 100.0));
+    dt         = static_cast<float>(1.0 / rateHz);
+    tickNs     = static_cast<int64_t>(1e9 / rateHz);
+    nextTickNs = latency::nowNs() + tickNs;
+    streamMask = 0;
+
+    const size_t sensors = static_cast<size_t>(numSensors);
+    for (const auto& chain : filters["chains"]) {
+        const auto streamName = chain.value("stream", std::string());
+        const auto typeName   = chain.value("type", std::string());
+
+        Bank bank;
+        if (!parseStreamName(streamName, bank.stream) || !parseType(typeName, bank.type)) {
+            juce::Logger::writeToLog("Unknown filter '" + juce::String(typeName) + "' on stream '"
+                                     + juce::String(streamName) + "', ignoring.");
+            continue;
+        }
+
+        bank.width       = streamValueCount(bank.stream);
+        bank.outWidth    = bank.type == Type::Jerk ? 1 : bank.width;
+        bank.wrapDegrees = bank.stream == SensorStream::Euler;
+
+        bank.minCutoff       = chain.value("min_cutoff", 1.0f);
+        bank.beta            = chain.value("beta", 0.0f);
+        bank.derivativeAlpha = smoothingAlpha(chain.value("d_cutoff", 1.0f), dt);
+
+        if (bank.type == Type::LowPass) {
+            const double fs = rateHz;
+            const double fc = std::min(chain.value("cutoff_hz", 10.0), 0.45 * fs);
+            const double q  = chain.value("q", 0.7071);
+            const double w0 = 2.0 * 3.14159265358979 * fc / fs;
+            const double alpha = std::sin(w0) / (2.0 * q);
+            const double c  = std::cos(w0);
+            const double a0 = 1.0 + alpha;
+            bank.b0 = static_cast<float>((1.0 - c) / 2.0 / a0);
+            bank.b1 = static_cast<float>((1.0 - c) / a0);
+            bank.b2 = bank.b0;
+            bank.a1 = static_cast<float>(-2.0 * c / a0);
+            bank.a2 = static_cast<float>((1.0 - alpha) / a0);
+        }
+
+        const size_t channels = sensors * static_cast<size_t>(bank.width);
+        for (auto* v : { &bank.raw, &bank.in, &bank.x1, &bank.x2, &bank.y, &bank.dx, &bank.z1, &bank.z2 })
+            v->assign(channels, 0.0f);
+        bank.out.assign(sensors * static_cast<size_t>(bank.outWidth), 0.0f);
+        bank.live.assign(sensors, 0);
+
+        const auto name = chain.value("name", streamName + "_" + typeName);
+        bank.messages.resize(sensors);
+        char address[48];
+        for (int i = 0; i < numSensors; ++i) {
+            std::snprintf(address, sizeof address, "/%s/%d", name.c_str(), i);
+            if (!bank.messages[static_cast<size_t>(i)].build(address, bank.outWidth))
+                juce::Logger::writeToLog("Filter address '" + juce::String(name) + "' is too long.");
+        }
+
+        streamMask |= 1u << static_cast<int>(bank.stream);
+        banks.push_back(std::move(bank));
+    }
+
+    if (banks.empty())
+        return false;
+
+    for (int s = 0; s < kNumSensorStreams; ++s) {
+        input[s].assign(sensors * 4, 0.0f);
+        present[s].assign(sensors, 0);
+    }
+
+    FrameAligner::Options resampling;
+    resampling.rateHz     = rateHz;
+    resampling.delayMs    = std::max(0.0, filters.value("delay_ms", 20.0));
+    resampling.streamMask = streamMask;
+    resampler.prepare(numSensors, resampling);
+    return true;
+}
+
+int FilterStage::waitMs(int64_t nowNs) const {
+    const int64_t remaining = (nextTickNs - nowNs + 999999) / 1000000;
+    return static_cast<int>(std::clamp<int64_t>(remaining, 1, 100));
+}
+
+// ---------------------------------------------------------------------------
+// Per tick
+// ---------------------------------------------------------------------------
+
+void FilterStage::run(double frameMs) {
+    SensorSample sample;
+    for (int s = 0; s < kNumSensorStreams; ++s) {
+        if (!(streamMask & (1u << s)))
+            continue;
+        for (int i = 0; i < numSensors; ++i) {
+            const bool ok = resampler.sampleAt(i, static_cast<SensorStream>(s), frameMs, sample);
+            present[s][static_cast<size_t>(i)] = ok;
+            if (ok)
+                std::copy(sample.values, sample.values + 4, &input[s][static_cast<size_t>(i) * 4]);
+        }
+    }
+
+    for (auto& bank : banks)
+        process(bank);
+}
+
+// Starts a sensor's channels from `values` as if the input had been constant.
+void FilterStage::reset(Bank& bank, int sensor, const float* values) const {
+    const bool derivative = bank.type != Type::OneEuro && bank.type != Type::LowPass;
+    for (int k = 0; k < bank.width; ++k) {
+        const size_t c = static_cast<size_t>(sensor * bank.width + k);
+        const float  x = values[k];
+        bank.raw[c] = bank.in[c] = bank.x1[c] = bank.x2[c] = x;
+        bank.y[c]   = derivative ? 0.0f : x;
+        bank.dx[c]  = 0.0f;
+        bank.z1[c]  = x * (1.0f - bank.b0);
+        bank.z2[c]  = x * (bank.b2 - bank.a2);
+    }
+}
+
+void FilterStage::process(Bank& bank) {
+    const int s = static_cast<int>(bank.stream);
+    const int width = bank.width;
+
+    // Gather: sensors that (re)appear start from their current value so the
+    // filters neither ring nor report a derivative spike.
+    for (int i = 0; i < numSensors; ++i) {
+        const bool now = present[s][static_cast<size_t>(i)] != 0;
+        const float* values = &input[s][static_cast<size_t>(i) * 4];
+        if (now && !bank.live[static_cast<size_t>(i)])
+            reset(bank, i, values);
+        bank.live[static_cast<size_t>(i)] = now;
+        std::copy(values, values + width, &bank.raw[static_cast<size_t>(i * width)]);
+    }
+
+    const size_t n = bank.in.size();
+    float* __restrict raw = bank.raw.data();
+    float* __restrict in  = bank.in.data();
+    float* __restrict x1  = bank.x1.data();
+    float* __restrict x2  = bank.x2.data();
+    float* __restrict y   = bank.y.data();
+    const float invDt = 1.0f / dt;
+
+    // Unwrap angles: follow the raw value along the shorter arc.
+    if (bank.wrapDegrees) {
+        for (size_t c = 0; c < n; ++c) {
+            const float d = raw[c] - in[c];
+            in[c] += d - 360.0f * std::nearbyint(d * (1.0f / 360.0f));
+        }
+    } else {
+        std::copy(raw, raw + n, in);
+    }
+
+    switch (bank.type) {
+        case Type::OneEuro: {
+            float* __restrict dx = bank.dx.data();
+            const float aD = bank.derivativeAlpha, minCutoff = bank.minCutoff, beta = bank.beta;
+            const float k = kTwoPi * dt;
+            for (size_t c = 0; c < n; ++c) {
+                dx[c] += aD * ((in[c] - y[c]) * invDt - dx[c]);
+                const float cutoff = minCutoff + beta * std::fabs(dx[c]);
+                const float a = (k * cutoff) / (1.0f + k * cutoff);
+                y[c] += a * (in[c] - y[c]);
+            }
+            break;
+        }
+        case Type::LowPass: {
+            float* __restrict z1 = bank.z1.data();
+            float* __restrict z2 = bank.z2.data();
+            const float b0 = bank.b0, b1 = bank.b1, b2 = bank.b2, a1 = bank.a1, a2 = bank.a2;
+            for (size_t c = 0; c < n; ++c) {
+                const float out = b0 * in[c] + z1[c];
+                z1[c] = b1 * in[c] - a1 * out + z2[c];
+                z2[c] = b2 * in[c] - a2 * out;
+                y[c]  = out;
+            }
+            break;
+        }
+        case Type::Derivative:
+        case Type::Jerk:
+            for (size_t c = 0; c < n; ++c) {
+                y[c]  = (in[c] - x1[c]) * invDt;
+                x1[c] = in[c];
+            }
+            break;
+        case Type::Derivative2: {
+            const float invDt2 = invDt * invDt;
+            for (size_t c = 0; c < n; ++c) {
+                y[c]  = (in[c] - 2.0f * x1[c] + x2[c]) * invDt2;
+                x2[c] = x1[c];
+                x1[c] = in[c];
+            }
+            break;
+        }
+    }
+
+    // Scatter to the published layout.
+    float* __restrict out = bank.out.data();
+    if (bank.type == Type::Jerk) {
+        for (int i = 0; i < numSensors; ++i) {
+            float sum = 0.0f;
+            for (int k = 0; k < width; ++k)
+                sum += y[i * width + k] * y[i * width + k];
+            out[i] = std::sqrt(sum);
+        }
+    } else if (bank.wrapDegrees && (bank.type == Type::OneEuro || bank.type == Type::LowPass)) {
+        // Smoothed angles back into the stream's ranges: heading/yaw (values
+        // 0 and 3) in [0, 360), pitch and roll in [-180, 180].
+        for (size_t c = 0; c < n; ++c) {
+            const float v = raw[c] + (y[c] - in[c]);
+            const size_t k = c % 4;
+            out[c] = (k == 0 || k == 3) ? v - 360.0f * std::floor(v * (1.0f / 360.0f))
+                                        : v - 360.0f * std::nearbyint(v * (1.0f / 360.0f));
+        }
+    } else {
+        std::copy(y, y + n, out);
+    }
+}
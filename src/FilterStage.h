@@ -0,0 +1,129 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "FrameAligner.h"
+#include "OscPacketEncoder.h"
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Host-side filter stage: smoothing and derivatives computed once for every
+// receiver.
+//
+// Inputs are resampled onto a fixed clock through a private FrameAligner, so
+// every filter runs with a constant dt. Each configured filter is a bank
+// whose state is stored struct-of-arrays over all (sensor, value) channels;
+// one tick is a handful of flat loops over the whole rig that the compiler
+// vectorises. Results go out as one bundle per tick under each bank's own
+// address, /{name}/{index}.
+//
+// config["filters"]:
+//     "rate_hz": 100,       filter clock
+//     "delay_ms": 20,       resampling delay (0 = hold the newest sample)
+//     "chains": [
+//         { "stream": "acc",   "type": "one_euro", "min_cutoff": 1.0, "beta": 0.01, "d_cutoff": 1.0 },
+//         { "stream": "gyro",  "type": "lowpass", "cutoff_hz": 8, "q": 0.707 },
+//         { "stream": "euler", "type": "derivative" },     d/dt, per value
+//         { "stream": "euler", "type": "derivative2" },    d2/dt2, per value
+//         { "stream": "acc",   "type": "jerk" }            |d/dt|, one value
+//     ]
+// "name" overrides the address (default "{stream}_{type}", e.g. /acc_one_euro/0).
+// Euler angles are unwrapped first, so nothing jumps at the 0/360 seam.
+// ---------------------------------------------------------------------------
+
+class FilterStage {
+public:
+    enum class Type { OneEuro, LowPass, Derivative, Derivative2, Jerk };
+
+    // Builds the banks from config["filters"]. Returns false if none.
+    bool configure(const nlohmann::json& filters, int numSensors);
+
+    bool enabled() const { return !banks.empty(); }
+
+    // Streaming thread: feeds a drained sample to the resampler.
+    void push(int sensor, const SensorSample& sample) { resampler.push(sensor, sample); }
+
+    // Streaming thread: runs every filter tick due by `nowNs` and emits each
+    // frame into `sink` (osc::StageSink).
+    template <typename Sink>
+    void tick(int64_t nowNs, Sink& sink) {
+        int emitted = 0;
+        while (nowNs >= nextTickNs) {
+            if (++emitted > kMaxCatchUp) {
+                nextTickNs = nowNs + tickNs;
+                break;
+            }
+            const double frameMs = static_cast<double>(nextTickNs) * 1e-6 - resampler.delayMs();
+            nextTickNs += tickNs;
+            run(frameMs);
+
+            sink.begin(osc::timeTagFromEpochMs(FrameAligner::hostToEpochMs(frameMs)));
+            for (auto& bank : banks) {
+                const uint32_t source = 1u << static_cast<int>(bank.stream);
+                for (int sensor = 0; sensor < numSensors; ++sensor) {
+                    if (!bank.live[static_cast<size_t>(sensor)])
+                        continue;
+                    auto& message = bank.messages[static_cast<size_t>(sensor)];
+                    message.setValues(&bank.out[static_cast<size_t>(sensor * bank.outWidth)]);
+                    sink.add(sensor, source, message);
+                }
+            }
+            sink.end();
+        }
+    }
+
+    int waitMs(int64_t nowNs) const;
+
+private:
+    static constexpr int kMaxCatchUp = 4;
+
+    // One filter over one stream of every sensor. Channel c is value
+    // c % width of sensor c / width.
+    struct Bank {
+        Type         type   = Type::OneEuro;
+        SensorStream stream = SensorStream::Acc;
+        int          width    = 3;   // values per sensor in
+        int          outWidth = 3;   // values per sensor out
+        bool         wrapDegrees = false;
+
+        // One-euro
+        float minCutoff = 1.0f, beta = 0.0f, derivativeAlpha = 1.0f;
+        // Biquad low-pass (RBJ), direct form II transposed
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+
+        // Per channel
+        std::vector<float> raw;      // last raw input (for unwrapping)
+        std::vector<float> in;       // current input, unwrapped
+        std::vector<float> x1, x2;   // previous inputs
+        std::vector<float> y;        // filter output / derivative
+        std::vector<float> dx;       // one-euro derivative estimate
+        std::vector<float> z1, z2;   // biquad state
+        std::vector<float> out;      // per sensor * outWidth, published
+
+        std::vector<uint8_t>                 live;       // per sensor: had input this tick
+        std::vector<osc::OscMessageTemplate> messages;   // per sensor
+    };
+
+    void run(double frameMs);
+    void reset(Bank& bank, int sensor, const float* values) const;
+    void process(Bank& bank);
+
+    int     numSensors = 0;
+    float   dt         = 0.01f;
+    int64_t tickNs     = 0;
+    int64_t nextTickNs = 0;
+
+    FrameAligner      resampler;
+    std::vector<Bank> banks;
+
+    // Resampled input per stream: numSensors * 4 floats, plus a presence flag.
+    std::vector<float>   input[kNumSensorStreams];
+    std::vector<uint8_t> present[kNumSensorStreams];
+    uint32_t             streamMask = 0;
+};
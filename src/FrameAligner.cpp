@@ -0,0 +1,222 @@
+//
+//  FrameAligner.cpp
+//
+//  Per-board clock models, sample histories and interpolation onto a shared
+//  output clock.
+//
+
+#include "FrameAligner.h"
+#include "LatencyTracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr double kWindowMs = 1000.0;   // clock model window
+constexpr double kResetMs  = 500.0;    // offset jump that means the epoch was re-anchored
+constexpr double kMaxDrift = 1e-3;     // 1000 ppm; crystals are well inside this
+
+// Spherical interpolation between unit quaternions (w, x, y, z), taking the
+// shorter arc.
+void slerp(const float* a, const float* b, double f, float* out) {
+    double dot = 0.0;
+    for (int k = 0; k < 4; ++k)
+        dot += static_cast<double>(a[k]) * b[k];
+    const double sign = dot < 0.0 ? -1.0 : 1.0;
+    dot *= sign;
+
+    double wa = 1.0 - f, wb = f * sign;
+    if (dot < 0.9995) {
+        const double theta = std::acos(dot);
+        const double s     = std::sin(theta);
+        wa = std::sin((1.0 - f) * theta) / s;
+        wb = sign * std::sin(f * theta) / s;
+    }
+
+    double norm = 0.0;
+    double q[4];
+    for (int k = 0; k < 4; ++k) {
+        q[k] = wa * a[k] + wb * b[k];
+        norm += q[k] * q[k];
+    }
+    norm = norm > 0.0 ? 1.0 / std::sqrt(norm) : 1.0;
+    for (int k = 0; k < 4; ++k)
+        out[k] = static_cast<float>(q[k] * norm);
+}
+
+// Euler angles in degrees: interpolate each angle along the shorter arc.
+// Heading/yaw (0 and 3) stay in [0, 360), pitch and roll in [-180, 180).
+void lerpAngles(const float* a, const float* b, double f, float* out) {
+    for (int k = 0; k < 4; ++k) {
+        double v = a[k] + f * std::remainder(static_cast<double>(b[k]) - a[k], 360.0);
+        if (k == 0 || k == 3)
+            v = std::fmod(v + 360.0, 360.0);
+        else if (v >= 180.0)
+            v -= 360.0;
+        else if (v < -180.0)
+            v += 360.0;
+        out[k] = static_cast<float>(v);
+    }
+}
+
+} // namespace
+
+FrameAligner::Options FrameAligner::Options::fromConfig(const nlohmann::json& align) {
+    Options o;
+    o.rateHz  = std::max(1.0, align.value("rate_hz", o.rateHz));
+    o.delayMs = std::max(0.0, align.value("delay_ms", o.delayMs));
+    o.holdMs  = std::max(0.0, align.value("hold_ms", o.holdMs));
+    if (align.contains("streams")) {
+        o.streamMask = streamMaskFromJson(align["streams"], [](const std::string& name) {
+            juce::Logger::writeToLog("Unknown stream '" + juce::String(name) + "' in align config, ignoring.");
+        });
+    }
+    return o;
+}
+
+void FrameAligner::prepare(int numSensorsIn, const Options& optionsIn) {
+    options    = optionsIn;
+    numSensors = numSensorsIn;
+    tickNs     = static_cast<int64_t>(1e9 / options.rateHz);
+    nextTickNs = latency::nowNs() + tickNs;
+    clocks.assign(static_cast<size_t>(numSensors), ClockModel{});
+    histories.assign(static_cast<size_t>(numSensors) * kNumSensorStreams, History{});
+    encoder.prepare(numSensors, "/sync");
+}
+
+int FrameAligner::waitMs(int64_t nowNs) const {
+    const int64_t remaining = (nextTickNs - nowNs + 999999) / 1000000;
+    return static_cast<int>(std::clamp<int64_t>(remaining, 1, 100));
+}
+
+// ---------------------------------------------------------------------------
+// Clock model
+// ---------------------------------------------------------------------------
+
+void FrameAligner::ClockModel::observe(double epochMs, double hostMs) {
+    const double offset = hostMs - epochMs;
+
+    // The SDK re-anchors the epoch on reconnect; start over.
+    if (valid && std::fabs(offset - (toHost(epochMs) - epochMs)) > kResetMs)
+        *this = ClockModel{};
+
+    if (!valid) {
+        valid       = true;
+        windowStart = windowEpoch = refEpoch = epochMs;
+        windowMin   = refOffset = offset;
+        return;
+    }
+
+    if (offset < windowMin) {
+        windowMin   = offset;
+        windowEpoch = epochMs;
+        // Until the first window closes, follow the running minimum.
+        if (!anchored) {
+            refOffset = windowMin;
+            refEpoch  = windowEpoch;
+        }
+    }
+
+    if (epochMs - windowStart < kWindowMs)
+        return;
+
+    if (anchored && windowEpoch > refEpoch) {
+        const double slope = std::clamp((windowMin - refOffset) / (windowEpoch - refEpoch), -kMaxDrift, kMaxDrift);
+        drift += 0.2 * (slope - drift);
+    }
+    refEpoch  = windowEpoch;
+    refOffset = windowMin;
+    anchored  = true;
+
+    windowStart = windowEpoch = epochMs;
+    windowMin   = offset;
+}
+
+// ---------------------------------------------------------------------------
+// Histories and interpolation
+// ---------------------------------------------------------------------------
+
+void FrameAligner::History::push(const Entry& e) {
+    if (count > 0) {
+        const double newest = at(count - 1).hostMs;
+        if (e.hostMs <= newest - kWindowMs)
+            start = count = 0;   // clock model restarted: old entries are on another timeline
+        else if (e.hostMs <= newest)
+            return;              // out of order
+    }
+    if (count < kHistory) {
+        entries[static_cast<size_t>((start + count) % kHistory)] = e;
+        ++count;
+    } else {
+        entries[static_cast<size_t>(start)] = e;
+        start = (start + 1) % kHistory;
+    }
+}
+
+void FrameAligner::push(int sensor, const SensorSample& s) {
+    if (sensor >= numSensors)
+        return;
+
+    const int64_t hostNs = s.notifyNs != 0 ? s.notifyNs : (s.handoffNs != 0 ? s.handoffNs : latency::nowNs());
+    ClockModel& clock = clocks[static_cast<size_t>(sensor)];
+    clock.observe(static_cast<double>(s.epoch), static_cast<double>(hostNs) * 1e-6);
+
+    const int stream = static_cast<int>(s.stream);
+    if (!(options.streamMask & (1u << stream)))
+        return;
+
+    Entry e;
+    e.hostMs = clock.toHost(static_cast<double>(s.epoch));
+    std::copy(s.values, s.values + 4, e.values);
+    History& h = histories[static_cast<size_t>(sensor * kNumSensorStreams + stream)];
+    h.numValues = s.numValues;
+    h.push(e);
+}
+
+bool FrameAligner::interpolate(int sensor, int stream, double frameMs, SensorSample& out) const {
+    const History& h = histories[static_cast<size_t>(sensor * kNumSensorStreams + stream)];
+    if (h.count == 0 || frameMs < h.at(0).hostMs)
+        return false;
+
+    out.stream    = static_cast<SensorStream>(stream);
+    out.numValues = h.numValues;
+
+    const Entry& newest = h.at(h.count - 1);
+    if (frameMs >= newest.hostMs) {
+        if (frameMs - newest.hostMs > options.holdMs)
+            return false;   // stale: the sensor has stopped sending
+        std::copy(newest.values, newest.values + 4, out.values);
+        return true;
+    }
+
+    // The output clock trails the newest samples, so search from the end.
+    int i = h.count - 1;
+    while (i > 1 && h.at(i - 1).hostMs > frameMs)
+        --i;
+    const Entry& a = h.at(i - 1);
+    const Entry& b = h.at(i);
+    const double f = (frameMs - a.hostMs) / (b.hostMs - a.hostMs);
+
+    switch (out.stream) {
+        case SensorStream::Quat:
+            slerp(a.values, b.values, f, out.values);
+            break;
+        case SensorStream::Euler:
+            lerpAngles(a.values, b.values, f, out.values);
+            break;
+        default:
+            for (int k = 0; k < 4; ++k)
+                out.values[k] = static_cast<float>(a.values[k] + f * (b.values[k] - a.values[k]));
+            break;
+    }
+    return true;
+}
+
+int64_t FrameAligner::hostToEpochMs(double hostMs) {
+    const double wallMs = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()) * 1e-3;
+    const double steadyMs = static_cast<double>(latency::nowNs()) * 1e-6;
+    return static_cast<int64_t>(hostMs + (wallMs - steadyMs));
+}
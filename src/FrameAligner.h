@@ -0,0 +1,145 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "OscPacketEncoder.h"
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Multi-sensor time alignment.
+//
+// Every sensor streams on its own schedule, so samples drained in one pass
+// of the streaming loop can be tens of ms apart. FrameAligner maps each
+// board's MetaWear epochs onto the host clock (tracking offset and drift per
+// board), keeps a short history per (sensor, stream), and on a fixed output
+// clock interpolates every sensor to the same instant: slerp for quaternions,
+// shortest-arc for Euler angles, linear for vectors. Each tick becomes one
+// bundle of /sync/{stream}/{index} messages timetagged with that instant.
+//
+// The output clock runs `delay_ms` behind real time so that, for every
+// sensor, a sample after the output instant has usually arrived already.
+//
+// config["align"]:
+//     "rate_hz": 100,               output frames per second
+//     "delay_ms": 40,               output clock lag behind the host clock
+//     "hold_ms": 100,               hold a stream's last value this long past its newest sample
+//     "streams": ["quat", "acc"]    streams to align (default: quat)
+// ---------------------------------------------------------------------------
+
+class FrameAligner {
+public:
+    struct Options {
+        double   rateHz     = 100.0;
+        double   delayMs    = 40.0;
+        double   holdMs     = 100.0;
+        uint32_t streamMask = 1u << static_cast<int>(SensorStream::Quat);
+
+        static Options fromConfig(const nlohmann::json& align);
+    };
+
+    // Sizes every buffer; the streaming path does not allocate afterwards.
+    void prepare(int numSensors, const Options& options);
+
+    // Streaming thread: adds a drained sample to its sensor's history.
+    void push(int sensor, const SensorSample& sample);
+
+    // Streaming thread: builds the frame for every output tick due by
+    // `nowNs` (host steady clock) and emits it into `sink` (osc::StageSink).
+    template <typename Sink>
+    void tick(int64_t nowNs, Sink& sink) {
+        int emitted = 0;
+        while (nowNs >= nextTickNs) {
+            // After a stall, skip ahead rather than bursting old frames.
+            if (++emitted > kMaxCatchUp) {
+                nextTickNs = nowNs + tickNs;
+                break;
+            }
+            const double frameMs = static_cast<double>(nextTickNs) * 1e-6 - options.delayMs;
+            nextTickNs += tickNs;
+
+            sink.begin(osc::timeTagFromEpochMs(hostToEpochMs(frameMs)));
+            SensorSample out;
+            for (int sensor = 0; sensor < numSensors; ++sensor) {
+                for (int stream = 0; stream < kNumSensorStreams; ++stream) {
+                    if (!(options.streamMask & (1u << stream)) || !interpolate(sensor, stream, frameMs, out))
+                        continue;
+                    sink.add(sensor, 1u << stream, encoder.encode(sensor, out));
+                }
+            }
+            sink.end();
+        }
+    }
+
+    // The value of one stream interpolated to `frameMs` (host steady-clock
+    // ms); false if the sensor has no usable data for that instant. For
+    // stages that resample through an aligner of their own.
+    bool sampleAt(int sensor, SensorStream stream, double frameMs, SensorSample& out) const {
+        return interpolate(sensor, static_cast<int>(stream), frameMs, out);
+    }
+
+    // How long the streaming loop may sleep before the next tick is due.
+    int waitMs(int64_t nowNs) const;
+
+    bool enabled() const { return numSensors > 0; }
+    double delayMs() const { return options.delayMs; }
+
+    // Host steady-clock ms to wall-clock epoch ms, for timetags.
+    static int64_t hostToEpochMs(double hostMs);
+
+private:
+    static constexpr int kHistory    = 32;   // samples kept per (sensor, stream)
+    static constexpr int kMaxCatchUp = 4;
+
+    // Maps a board's epoch (ms) to host steady-clock ms. Offset is the
+    // lower envelope of (host - epoch) over one-second windows, which strips
+    // BLE queueing delay; drift is the smoothed slope between windows.
+    struct ClockModel {
+        bool   valid       = false;
+        bool   anchored    = false;   // at least one window has closed
+        double refEpoch    = 0.0;     // anchor: epoch and offset of the last window minimum
+        double refOffset   = 0.0;
+        double drift       = 0.0;     // host ms gained per epoch ms
+        double windowStart = 0.0;     // current window: start epoch and minimum
+        double windowMin   = 0.0;
+        double windowEpoch = 0.0;
+
+        void   observe(double epochMs, double hostMs);
+        double toHost(double epochMs) const {
+            return epochMs + refOffset + drift * (epochMs - refEpoch);
+        }
+    };
+
+    struct Entry {
+        double hostMs = 0.0;
+        float  values[4] = {};
+    };
+
+    // Fixed ring of the newest kHistory entries, oldest first from `start`.
+    struct History {
+        std::array<Entry, kHistory> entries;
+        int     start = 0;
+        int     count = 0;
+        uint8_t numValues = 0;
+
+        const Entry& at(int i) const { return entries[static_cast<size_t>((start + i) % kHistory)]; }
+        void push(const Entry& e);
+    };
+
+    bool interpolate(int sensor, int stream, double frameMs, SensorSample& out) const;
+
+    Options options;
+    int     numSensors = 0;
+    int64_t tickNs     = 0;
+    int64_t nextTickNs = 0;
+
+    std::vector<ClockModel> clocks;      // per sensor
+    std::vector<History>    histories;   // per (sensor, stream)
+
+    osc::OscPacketEncoder encoder;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Hot-path latency tracing.
+//
+// Every SensorSample is stamped at three points on its way through a
+// MetaMotionController (BLE notification arrival, SDK data callback, queue
+// handoff); the streaming thread adds the fourth when the encoded packet has
+// been handed to the per-destination send queues.
+// Stage durations go into per-sensor log-linear histograms made of relaxed
+// atomics, so recording is lock-free and reports can be read from any thread.
+// ---------------------------------------------------------------------------
+
+namespace latency {
+
+inline int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum class Stage : uint8_t {
+    NotifyToCallback,   // BLE notification -> SDK data callback
+    CallbackToHandoff,  // SDK data callback -> snapshot published and sample queued
+    HandoffToSend,      // queued -> packet handed to the OSC fan-out
+    Total,              // BLE notification -> packet handed to the OSC fan-out
+    Count
+};
+
+constexpr int kNumStages = static_cast<int>(Stage::Count);
+
+// Log-linear histogram of nanosecond values: 8 sub-buckets per power of two
+// (<= 12.5 % error), covering 0 ns to ~18 minutes.
+class Histogram {
+public:
+    static constexpr int kSubBits    = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kMaxMsb     = 40;
+    static constexpr int kNumBuckets = (kMaxMsb - kSubBits + 2) * kSubBuckets;
+
+    void record(int64_t ns) {
+        const uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        buckets_[bucketFor(v)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t prev = max_.load(std::memory_order_relaxed);
+        while (v > prev && !max_.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+    }
+
+    // Upper bound of the bucket holding quantile `q` (0..1), in ns.
+    uint64_t percentile(double q) const {
+        const uint64_t total = count_.load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+        const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < kNumBuckets; ++b) {
+            seen += buckets_[b].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(bucketUpperBound(b), max());
+        }
+        return max();
+    }
+
+    uint64_t max() const   { return max_.load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    void reset() {
+        for (auto& b : buckets_)
+            b.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static int msb(uint64_t v) {
+        int r = 0;
+        for (int shift = 32; shift > 0; shift >>= 1) {
+            if (v >> shift) {
+                v >>= shift;
+                r += shift;
+            }
+        }
+        return r;
+    }
+
+    static int bucketFor(uint64_t v) {
+        if (v < kSubBuckets)
+            return static_cast<int>(v);
+        const int top = msb(v);
+        if (top > kMaxMsb)
+            return kNumBuckets - 1;
+        const int shift = top - kSubBits;
+        return (shift + 1) * kSubBuckets + static_cast<int>((v >> shift) & (kSubBuckets - 1));
+    }
+
+    static uint64_t bucketUpperBound(int bucket) {
+        if (bucket < kSubBuckets)
+            return static_cast<uint64_t>(bucket);
+        const int shift = bucket / kSubBuckets - 1;
+        const uint64_t lower = static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << shift;
+        return lower + ((uint64_t(1) << shift) - 1);
+    }
+
+    std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Stage histograms for one sensor.
+struct SensorLatency {
+    std::array<Histogram, kNumStages> stages;
+
+    Histogram& operator[](Stage s) { return stages[static_cast<int>(s)]; }
+    const Histogram& operator[](Stage s) const { return stages[static_cast<int>(s)]; }
+
+    // Records all stages of a sample whose packet finished sending at `sentNs`.
+    void record(const SensorSample& s, int64_t sentNs) {
+        if (s.notifyNs == 0)
+            return;   // not stamped (e.g. synthesised sample)
+        (*this)[Stage::NotifyToCallback].record(s.callbackNs - s.notifyNs);
+        (*this)[Stage::CallbackToHandoff].record(s.handoffNs - s.callbackNs);
+        (*this)[Stage::HandoffToSend].record(sentNs - s.handoffNs);
+        (*this)[Stage::Total].record(sentNs - s.notifyNs);
+    }
+
+    void reset() {
+        for (auto& h : stages)
+            h.reset();
+    }
+};
+
+} // namespace latency
@@ -1,6 +1,20 @@
 #include <JuceHeader.h>
+#include "ConnectionPool.h"
+#include "FeatureStage.h"
+#include "FilterStage.h"
+#include "FrameAligner.h"
+#include "LatencyTracer.h"
 #include "MetaMotionController.h"
+#include "OrientationStage.h"
+#include "OscFanout.h"
+#include "OscPacketEncoder.h"
+#include "OscRouting.h"
+#include "ReconnectSupervisor.h"
+#include "SessionRecording.h"
+#include "SharedMemoryOutput.h"
+#include "SimulatedMetaWear.h"
 #include <csignal>
+#include <ctime>
 #include <atomic>
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -10,118 +24,707 @@ using json = nlohmann::json;
 // Set to true by the SIGINT handler to trigger a clean shutdown.
 std::atomic<bool> g_shutdown_requested{false};
 
+// Command-line recording/replay options.
+struct SessionOptions {
+    std::string recordPath;         // --record <file>: capture every sample sent
+    std::string replayPath;         // --replay <file>: stream a capture instead of sensors
+    bool        replayFast = false; // --replay-fast: ignore recorded timing
+};
+
 // ---------------------------------------------------------------------------
 // MetaOSCThread
 //
 // Owns the BLE interface, MetaWear controllers, and OSC senders.
-// Constructor blocks while scanning and connecting; run() streams sensor
-// data at ~10 Hz to all configured OSC servers.
+// Constructor blocks while scanning and connecting; run() sleeps until a
+// controller queues a new sample and forwards it to all configured OSC
+// servers as soon as it arrives.
 // ---------------------------------------------------------------------------
 
 class MetaOSCThread : public juce::Thread {
+public:
+    // How samples are packed into UDP datagrams (config key "bundle").
+    enum class BundleMode {
+        Off,        // "off":    one OSC message per sample
+        PerSensor,  // "sensor": one bundle per sensor per wake-up
+        AllSensors  // "all":    one bundle for the whole rig per wake-up
+    };
+
+private:
     BleInterface                   bleInterface;
     OwnedArray<MetaMotionController> controllers;
     std::vector<SimpleBLE::Peripheral> peripherals;
-    OwnedArray<juce::OSCSender>    oscSenders;
+    juce::WaitableEvent            sampleAvailable;   // signalled by controller callbacks
+
+    // Sample sources drained by run(), indexed by OSC sensor index: the
+    // controllers' queues, or the replay queues in --replay mode.
+    std::vector<MetaMotionController::SampleQueue*> sampleQueues;
+    int numSensors = 0;
+
+    SessionRecorder recorder;
+    SessionReplay   replay;
+    bool            recording = false;
+    bool            replaying = false;
+    BundleMode bundleMode = BundleMode::Off;
     bool verboseLogging;
+    bool replayFast = false;
+
+    // Throughput statistics, logged every statsIntervalMs (0 = off).
+    int      statsIntervalMs = 0;
+    int      linkCheckMs     = 5000;   // config "link_check_ms", 0 = off
+    uint64_t samplesSent = 0;
+    uint64_t packetsSent = 0;
+    std::vector<std::array<uint64_t, kNumSensorStreams>> streamSamples;   // per sensor, since last report
+
+    // Latency tracing (config "latency"): per-sensor stage histograms,
+    // reported every latencyReportMs (0 = off) and optionally published as
+    // /metaosc/latency/{index} total_p50 total_p99 total_max
+    //                           notify_p99 handoff_p99 send_p99   (microseconds)
+    using LatencyMessage = osc::BasicOscMessageTemplate<64, 6>;
+    int  latencyReportMs = 0;
+    bool latencyOsc      = false;
+    std::unique_ptr<latency::SensorLatency[]> latencies;
+    std::vector<LatencyMessage>               latencyMessages;
+    std::vector<std::pair<int, SensorSample>> pendingTraces;   // AllSensors: samples awaiting the rig send
+
+    // pendingTraces never grows past this, so tracing does not allocate in
+    // the streaming loop; samples beyond it in one pass go untraced.
+    static constexpr size_t kMaxPendingTraces = 4096;
+
+    static BundleMode parseBundleMode(const json& config) {
+        if (!config.contains("bundle"))
+            return BundleMode::Off;
+        auto mode = config["bundle"].get<std::string>();
+        if (mode == "sensor") return BundleMode::PerSensor;
+        if (mode == "all")    return BundleMode::AllSensors;
+        if (mode != "off")
+            juce::Logger::writeToLog("Unknown bundle mode '" + juce::String(mode) + "', sending plain messages.");
+        return BundleMode::Off;
+    }
+
+    // UDP destinations from config["servers"]. Packets are queued per
+    // destination and sent by its own worker, so run() never blocks on a
+    // socket. Destinations are grouped into routes by their stream/sensor/
+    // rate filters; each route is encoded once per wake-up.
+    osc::OscFanout              fanout;
+    osc::OscRoutingTable        routing;
+    osc::OscPacketEncoder       encoder;
+
+    // Synchronised multi-sensor frames on a fixed clock (config "align").
+    FrameAligner aligner;
+
+    // Smoothed and differentiated streams (config "filters").
+    FilterStage filters;
+
+    // Recentered, mounting- and world-corrected quaternions (config "orientation").
+    OrientationStage orientation;
+
+    // Windowed motion features under /feat (config "features").
+    FeatureStage features;
+
+    // Every sample as a fixed record in a shared-memory ring (config "shm").
+    SharedMemoryOutput shm;
+
+    // Reconnects sensors that drop out, keeping their OSC indices.
+    std::unique_ptr<ReconnectSupervisor> supervisor;
+
+    // Samples drained from one queue per pass; sized so that a per-sensor
+    // bundle of this many samples always fits in one packet.
+    static constexpr size_t kMaxBatch =
+        (osc::kMaxPacketSize - 2 * osc::OscPacketBuilder::kBundleHeaderSize
+                             - osc::OscPacketBuilder::kElementPrefixSize)
+        / osc::OscPacketEncoder::kMaxSampleSize;
+
+    // Connects and initialises one controller, waiting on its `ready` future
+    // rather than a fixed delay. Runs on a ConnectionPool worker.
+    static bool connectController(MetaMotionController* c, int timeoutMs) {
+        const auto begin = std::chrono::steady_clock::now();
+        bool ok = false;
+        try {
+            c->transport->connect();
+            c->setup();
+            // Initialisation advances on SDK callbacks; poll only to enforce
+            // the per-step timeouts and the overall deadline.
+            const auto deadline = begin + std::chrono::milliseconds(timeoutMs);
+            while (c->ready.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+                c->poll_init_timeout();
+                if (std::chrono::steady_clock::now() > deadline) {
+                    // Leave nothing mid-step: the supervisor only retries
+                    // sensors that ended in Failed.
+                    c->fail_init("init deadline");
+                    break;
+                }
+            }
+            ok = c->ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+                 && c->ready.get();
+        } catch (const std::exception& e) {
+            juce::Logger::writeToLog("Sensor " + juce::String(c->address) + ": connect failed: " + e.what());
+            c->fail_init("connect failed");
+        }
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        juce::Logger::writeToLog(juce::String::formatted("Sensor %s: %s after %lld ms",
+            c->address.c_str(), ok ? "ready" : "NOT ready", (long long)ms));
+        return ok;
+    }
+
+    // Records a sample that at least one route sent; `sentNs` is taken after
+    // the packet carrying it was handed to the fan-out.
+    void traceSent(int index, const SensorSample& sample, int64_t sentNs) {
+        latencies[index].record(sample, sentNs);
+    }
+
+    // Logs p50/p99/max per sensor and optionally sends them over OSC, then
+    // starts a fresh measurement window.
+    void reportLatency() {
+        auto us = [](uint64_t ns) { return static_cast<float>(ns) / 1000.0f; };
+        for (int i = 0; i < numSensors; ++i) {
+            auto& l = latencies[i];
+            const auto& total = l[latency::Stage::Total];
+            if (total.count() == 0)
+                continue;
+
+            const float values[6] = {
+                us(total.percentile(0.5)), us(total.percentile(0.99)), us(total.max()),
+                us(l[latency::Stage::NotifyToCallback].percentile(0.99)),
+                us(l[latency::Stage::CallbackToHandoff].percentile(0.99)),
+                us(l[latency::Stage::HandoffToSend].percentile(0.99))
+            };
+            juce::Logger::writeToLog(juce::String::formatted(
+                "latency[%d] n=%llu total p50 %.0f us, p99 %.0f us, max %.0f us"
+                " | p99 notify->callback %.0f us, callback->queue %.0f us, queue->send %.0f us",
+                i, (unsigned long long)total.count(),
+                values[0], values[1], values[2], values[3], values[4], values[5]));
+
+            if (latencyOsc) {
+                latencyMessages[i].setValues(values);
+                for (auto& route : routing.all())
+                    if (route.wantsSensor(i))
+                        sendPacket(route, latencyMessages[i].data(), latencyMessages[i].size());
+            }
+            l.reset();
+        }
+    }
+
+    // Compares each sensor's BLE notification rate with what its configured
+    // outputs should produce, and warns when the link is the bottleneck.
+    void checkLinkRates() {
+        for (int i = 0; i < controllers.size(); ++i) {
+            auto* c = controllers[i];
+            if (!c->isConnected)
+                continue;
+            const auto rate = c->measure_link_rate();
+            if (rate.expectedHz <= 0.0)
+                continue;   // first measurement window
+            if (rate.notificationsHz < 0.9 * rate.expectedHz)
+                juce::Logger::writeToLog(juce::String::formatted(
+                    "link[%d] %s: %.0f notifications/s, expected %.0f; the BLE connection is limiting throughput",
+                    i, c->address.c_str(), rate.notificationsHz, rate.expectedHz));
+            else if (verboseLogging)
+                juce::Logger::writeToLog(juce::String::formatted("link[%d]: %.0f of %.0f notifications/s",
+                                                                 i, rate.notificationsHz, rate.expectedHz));
+        }
+    }
+
+    void sendPacket(const osc::OscRoute& route, const uint8_t* data, size_t size) {
+        for (int d : route.destinations)
+            fanout.publishTo(d, data, size);
+        ++packetsSent;
+    }
+
+    // Sends one sensor's samples on a route according to bundleMode. In
+    // AllSensors mode they are appended to the route's rig bundle instead.
+    void sendOnRoute(osc::OscRoute& route, int index, const SensorSample* samples, size_t count) {
+        switch (bundleMode) {
+            case BundleMode::Off:
+                for (size_t k = 0; k < count; ++k) {
+                    const auto& message = encoder.encode(index, samples[k]);
+                    sendPacket(route, message.data(), message.size());
+                }
+                break;
+            case BundleMode::PerSensor:
+                route.builder.reset();
+                encoder.appendSensorBundle(route.builder, index, samples, count);
+                sendPacket(route, route.builder.data(), route.builder.size());
+                break;
+            case BundleMode::AllSensors: {
+                auto& builder = route.builder;
+                const size_t needed = osc::OscPacketBuilder::kElementPrefixSize
+                                    + osc::OscPacketBuilder::kBundleHeaderSize
+                                    + count * osc::OscPacketEncoder::kMaxSampleSize;
+                if (!builder.empty() && builder.remaining() < needed)
+                    flushRigBundle(route);
+                const bool opening = builder.empty();
+                if (opening)
+                    route.rigTimeTagOffset = builder.beginBundle(0);
+                const int64_t epoch = encoder.appendSensorBundle(builder, index, samples, count);
+                route.rigEpoch = opening ? epoch : std::min(route.rigEpoch, epoch);
+                break;
+            }
+        }
+    }
+
+    // AllSensors: close, timetag and send the route's rig bundle built so far.
+    void flushRigBundle(osc::OscRoute& route) {
+        auto& builder = route.builder;
+        if (builder.empty()) return;
+        builder.endBundle();
+        builder.setTimeTag(route.rigTimeTagOffset, osc::timeTagFromEpochMs(route.rigEpoch));
+        sendPacket(route, builder.data(), builder.size());
+        builder.reset();
+    }
+
+    // Logs samples/s, packets/s and process CPU use since the last report.
+    void logStats(std::chrono::steady_clock::time_point& lastReport, std::clock_t& lastCpu) {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - lastReport).count();
+        if (seconds * 1000.0 < statsIntervalMs)
+            return;
+
+        const std::clock_t cpu = std::clock();
+        const double cpuPercent = 100.0 * (double(cpu - lastCpu) / CLOCKS_PER_SEC) / seconds;
+        uint64_t dropped = 0;
+        for (auto* c : controllers)
+            dropped += c->droppedSamples.load(std::memory_order_relaxed);
+        if (recording)
+            dropped += recorder.dropped();
+
+        juce::Logger::writeToLog(juce::String::formatted(
+            "stats: %.0f samples/s, %.0f packets/s, CPU %.1f%%, %llu queue drops",
+            samplesSent / seconds, packetsSent / seconds, cpuPercent, (unsigned long long)dropped));
+
+        for (int i = 0; i < fanout.size(); ++i) {
+            const auto d = fanout.takeStats(i);
+            if (d.dropped > 0 || d.errors > 0)
+                juce::Logger::writeToLog(juce::String::formatted(
+                    "stats: %s:%d sent %llu, dropped %llu (queue full), %llu send errors",
+                    fanout.host(i).c_str(), fanout.port(i), (unsigned long long)d.sent,
+                    (unsigned long long)d.dropped, (unsigned long long)d.errors));
+        }
+
+        // Achieved sample rate per sensor and stream.
+        for (size_t i = 0; i < streamSamples.size(); ++i) {
+            juce::String rates;
+            for (int s = 0; s < kNumSensorStreams; ++s) {
+                if (streamSamples[i][s] == 0)
+                    continue;
+                rates << juce::String::formatted(" %s %.1f Hz", streamAddressPrefix(static_cast<SensorStream>(s)) + 1,
+                                                 streamSamples[i][s] / seconds);
+                streamSamples[i][s] = 0;
+            }
+            if (rates.isNotEmpty())
+                juce::Logger::writeToLog(juce::String::formatted("stats: sensor %d:", (int)i) + rates);
+        }
+
+        samplesSent = packetsSent = 0;
+        lastReport  = now;
+        lastCpu     = cpu;
+    }
 
 public:
-    MetaOSCThread(const json& config, bool verbose = true)
-        : juce::Thread("MetaOSC Thread"), verboseLogging(verbose)
+    MetaOSCThread(const json& config, bool verbose = true, const SessionOptions& session = {})
+        : juce::Thread("MetaOSC Thread"),
+          bundleMode(parseBundleMode(config)),
+          verboseLogging(verbose),
+          statsIntervalMs(config.value("stats_interval_ms", 0)),
+          linkCheckMs(config.value("link_check_ms", 5000))
     {
-        // --- BLE scan ---
-        bleInterface.setup();
-        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-        peripherals = bleInterface.getMetaMotionPeripherals();
-
-        // Filter to only the MAC addresses listed in the config (if any).
-        auto macs = config["macs"].get<std::vector<std::string>>();
-        if (!macs.empty()) {
-            std::vector<SimpleBLE::Peripheral> filtered;
-            for (const auto& mac : macs) {
-                for (auto& p : peripherals) {
-                    if (p.identifier() == mac || p.address() == mac) {
-                        filtered.push_back(p);
-                        break;
-                    }
+        if (config.contains("latency")) {
+            latencyReportMs = config["latency"].value("report_ms", 5000);
+            latencyOsc      = config["latency"].value("osc", false);
+        }
+
+        const int  parallelism          = config.value("connect_parallelism", 4);
+        const int  connectTimeoutMs     = config.value("connect_timeout_ms", 10000);
+        const bool connectWhileScanning = config.value("connect_while_scanning", false);
+        const auto startupBegin         = std::chrono::steady_clock::now();
+
+        if (!session.replayPath.empty()) {
+            // --- Replay: the capture stands in for every sensor ---
+            replaying = replay.open(session.replayPath);
+            if (replaying) {
+                numSensors = replay.sensorCount();
+                for (int i = 0; i < numSensors; ++i)
+                    sampleQueues.push_back(&replay.queue(i));
+            }
+        }
+
+        // One slot per sensor; OSC indices follow slot order regardless of
+        // which sensor finishes connecting first.
+        std::vector<std::unique_ptr<MetaMotionController>> slots;
+        std::atomic<int> numReady{0};
+        {
+            // Connect and initialise sensors concurrently with bounded
+            // parallelism. Each BLE adapter gets its own pool so connection
+            // setup on one dongle never queues behind another; the pools'
+            // destructors wait for every job.
+            std::vector<std::unique_ptr<ConnectionPool>> pools;
+
+            auto startConnecting = [&](size_t slot, size_t adapter, int sensorsOnAdapter,
+                                       std::unique_ptr<BleTransport> transport) {
+                auto* controller = new MetaMotionController(std::move(transport));
+                controller->onSampleAvailable = [this] { sampleAvailable.signal(); };
+                controller->sensorConfig = SensorConfig::forAddress(config, controller->address);
+                controller->adapter = adapter;
+                controller->sensorsOnAdapter = sensorsOnAdapter;
+                slots[slot].reset(controller);
+                pools[adapter]->submit([controller, connectTimeoutMs, &numReady] {
+                    if (connectController(controller, connectTimeoutMs))
+                        ++numReady;
+                });
+            };
+
+            auto openPools = [&](size_t count) {
+                for (size_t i = 0; i < count; ++i)
+                    pools.push_back(std::make_unique<ConnectionPool>(parallelism));
+            };
+
+            // Deduplicated so slots, fair shares and the scan's early exit
+            // count each board once.
+            const auto macs = BleInterface::uniqueAddresses(config["macs"].get<std::vector<std::string>>());
+            if (!session.replayPath.empty()) {
+                // Replay already set up; no sensors to connect.
+            } else if (config.contains("simulate")) {
+                // --- Simulated boards: no BLE hardware involved ---
+                const auto& sim = config["simulate"];
+                const int simSensors = sim.value("sensors", 4);
+                const double rateHz  = sim.value("rate_hz", 100.0);
+                juce::Logger::writeToLog(juce::String::formatted(
+                    "Simulating %d MetaWear board(s) at %.1f Hz", simSensors, rateHz));
+                openPools(1);
+                slots.resize(static_cast<size_t>(simSensors));
+                for (int i = 0; i < simSensors; ++i)
+                    startConnecting(static_cast<size_t>(i), 0, simSensors,
+                                    std::make_unique<SimulatedMetaWearTransport>(i, rateHz));
+            } else if (!bleInterface.openAdapters()) {
+                // Nothing to scan with.
+            } else if (macs.empty()) {
+                // --- BLE scan: no allowlist, so scan for the full timeout ---
+                openPools(bleInterface.adapters.size());
+                bleInterface.setup();
+                std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+                const auto found = bleInterface.getMetaMotionPeripherals();
+                slots.resize(found.size());
+                for (size_t i = 0; i < found.size(); ++i) {
+                    peripherals.push_back(found[i].peripheral);
+                    startConnecting(i, found[i].adapter,
+                                    static_cast<int>(bleInterface.adapterLoad[found[i].adapter]),
+                                    std::make_unique<SimpleBleTransport>(found[i].peripheral));
                 }
+            } else {
+                // --- BLE scan: stop as soon as every configured MAC is seen ---
+                // Slots are sized up front so the scan callback can fill them
+                // (and, in streaming mode, start connecting) by target index.
+                openPools(bleInterface.adapters.size());
+                peripherals.resize(macs.size());
+                slots.resize(macs.size());
+                std::vector<bool>   found(macs.size(), false);
+                std::vector<size_t> adapterOf(macs.size(), 0);
+
+                // Streaming mode assigns targets before the final per-adapter
+                // counts are known; each adapter is capped at its fair share.
+                const size_t numAdapters = bleInterface.adapters.size();
+                const int    fairShare   = static_cast<int>((macs.size() + numAdapters - 1) / numAdapters);
+
+                bleInterface.scanForTargets(macs, SCAN_TIMEOUT_MS, connectWhileScanning,
+                    [&](size_t index, const BleInterface::Sighting& s) {
+                        peripherals[index] = s.peripheral;
+                        adapterOf[index] = s.adapter;
+                        found[index] = true;
+                        if (connectWhileScanning)
+                            startConnecting(index, s.adapter, fairShare,
+                                            std::make_unique<SimpleBleTransport>(s.peripheral));
+                    });
+
+                if (!connectWhileScanning)
+                    for (size_t i = 0; i < macs.size(); ++i)
+                        if (found[i])
+                            startConnecting(i, adapterOf[i],
+                                            static_cast<int>(bleInterface.adapterLoad[adapterOf[i]]),
+                                            std::make_unique<SimpleBleTransport>(peripherals[i]));
+            }
+        }
+
+        for (auto& slot : slots) {
+            if (slot) {
+                sampleQueues.push_back(&slot->samples);
+                controllers.add(slot.release());
+            }
+        }
+
+        if (!replaying) {
+            numSensors = controllers.size();
+
+            const auto startupMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - startupBegin).count();
+            juce::Logger::writeToLog(juce::String::formatted("%d of %d sensor(s) ready in %lld ms",
+                numReady.load(), controllers.size(), (long long)startupMs));
+
+            if (controllers.isEmpty())
+                juce::Logger::writeToLog("No MetaMotion controllers found!");
+
+            const auto reconnect = ReconnectOptions::fromConfig(config);
+            if (reconnect.enabled && !controllers.isEmpty()) {
+                std::vector<MetaMotionController*> sensors(controllers.begin(), controllers.end());
+                supervisor = std::make_unique<ReconnectSupervisor>(
+                    config.contains("simulate") ? nullptr : &bleInterface, std::move(sensors),
+                    [connectTimeoutMs](MetaMotionController* c) { return connectController(c, connectTimeoutMs); },
+                    reconnect);
+                supervisor->start();
             }
-            peripherals = filtered;
         }
 
-        // --- Connect and initialise each sensor ---
-        for (auto& p : peripherals) {
-            p.connect();
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-            auto* controller = new MetaMotionController(p);
-            controller->setup();
-            controllers.add(controller);
+        if (!session.recordPath.empty()) {
+            recording = recorder.open(session.recordPath);
+            juce::Logger::writeToLog((recording ? "Recording session to " : "Could not open recording file ")
+                                     + juce::String(session.recordPath));
         }
+        replayFast = session.replayFast;
+
+        // --- Build OSC packet templates and open UDP sockets ---
+        encoder.prepare(numSensors);
+        if (config.contains("align"))
+            aligner.prepare(numSensors, FrameAligner::Options::fromConfig(config["align"]));
+        if (config.contains("filters"))
+            filters.configure(config["filters"], numSensors);
+        if (config.contains("orientation")) {
+            std::vector<std::string> addresses(static_cast<size_t>(numSensors));
+            for (int i = 0; i < controllers.size() && i < numSensors; ++i)
+                addresses[static_cast<size_t>(i)] = controllers[i]->address;
+            orientation.configure(config["orientation"], addresses);
+        }
+        if (config.contains("features"))
+            features.configure(config["features"], numSensors);
 
-        if (controllers.isEmpty())
-            juce::Logger::writeToLog("No MetaMotion controllers found!");
+        latencies.reset(new latency::SensorLatency[static_cast<size_t>(numSensors)]);
+        latencyMessages.resize(static_cast<size_t>(numSensors));
+        for (int i = 0; i < numSensors; ++i)
+            latencyMessages[i].build(("/metaosc/latency/" + std::to_string(i)).c_str(), 6);
+        pendingTraces.reserve(kMaxPendingTraces);
+        streamSamples.assign(static_cast<size_t>(numSensors), {});
 
-        // --- Open OSC connections ---
         for (const auto& server : config["servers"]) {
-            auto* sender = new juce::OSCSender();
-            sender->connect(server["host"].get<std::string>(),
-                            server["port"].get<int>());
-            oscSenders.add(sender);
+            const int index = fanout.addDestination(
+                server["host"].get<std::string>(), server["port"].get<int>(), server.value("queue", 256),
+                osc::OscFanout::parsePolicy(server.value("overflow", std::string("drop_oldest"))));
+            routing.addDestination(server, index, numSensors, config);
         }
+        fanout.start();
+
+        if (config.contains("shm"))
+            shm.open(config["shm"], numSensors);
     }
 
-    // Main loop: poll each controller and broadcast sensor data over OSC.
+    // Main loop: wait for controllers to queue samples, then drain every
+    // queue and send each route the samples it selects, either as individual
+    // messages or packed into bundles according to bundleMode. Packets are
+    // encoded into preallocated buffers, so steady-state streaming does not
+    // touch the heap (verbose logging aside).
     void run() override {
-        // Helper: build an OSC message and send it to every configured server.
-        auto sendOSC = [&](const juce::String& address, std::initializer_list<float> values) {
-            juce::OSCMessage msg(address);
-            for (float v : values) msg.addFloat32(v);
-            for (auto& sender : oscSenders)
-                sender->send(msg);
-        };
+        if (replaying)
+            replay.start(replayFast,
+                         [this] { sampleAvailable.signal(); },
+                         [] { g_shutdown_requested.store(true); });
+
+        std::array<SensorSample, kMaxBatch> batch;
+        std::array<SensorSample, kMaxBatch> routed;
+        std::array<bool, kMaxBatch>         emitted;   // batch[k] went out on some route
+        auto stageSink = osc::makeStageSink(routing.all(),
+            [this](const osc::OscRoute& route, const uint8_t* data, size_t size) { sendPacket(route, data, size); });
+        auto lastStatsReport   = std::chrono::steady_clock::now();
+        auto lastStatsCpu      = std::clock();
+        auto lastLatencyReport = std::chrono::steady_clock::now();
+        auto lastLinkCheck     = std::chrono::steady_clock::now();
 
         while (!threadShouldExit() && !g_shutdown_requested.load()) {
-            for (int i = 0; i < controllers.size(); ++i) {
-                auto* c = controllers[i];
-                if (!c) continue;
+            // Timeout only bounds how long a shutdown request can go unnoticed,
+            // or when the next aligned / filtered frame or feature report is due.
+            int waitMs = 100;
+            if (aligner.enabled())
+                waitMs = std::min(waitMs, aligner.waitMs(latency::nowNs()));
+            if (filters.enabled())
+                waitMs = std::min(waitMs, filters.waitMs(latency::nowNs()));
+            if (features.enabled())
+                waitMs = std::min(waitMs, features.waitMs(latency::nowNs()));
+            sampleAvailable.wait(waitMs);
+
+            for (auto& route : routing.all())
+                route.builder.reset();
+
+            for (int i = 0; i < numSensors; ++i) {
+                auto* queue = sampleQueues[static_cast<size_t>(i)];
+
+                for (;;) {
+                    size_t count = 0;
+                    while (count < batch.size() && queue->pop(batch[count]))
+                        ++count;
+                    if (count == 0)
+                        break;
+                    samplesSent += count;
+
+                    if (recording)
+                        for (size_t k = 0; k < count; ++k)
+                            recorder.record(i, batch[k]);
+
+                    if (shm.enabled())
+                        for (size_t k = 0; k < count; ++k)
+                            shm.publish(i, batch[k]);
+
+                    if (aligner.enabled())
+                        for (size_t k = 0; k < count; ++k)
+                            aligner.push(i, batch[k]);
+
+                    if (filters.enabled())
+                        for (size_t k = 0; k < count; ++k)
+                            filters.push(i, batch[k]);
+
+                    if (orientation.enabled())
+                        for (size_t k = 0; k < count; ++k)
+                            orientation.push(i, batch[k]);
+
+                    if (features.enabled())
+                        for (size_t k = 0; k < count; ++k)
+                            features.push(i, batch[k]);
+
+                    if (statsIntervalMs > 0)
+                        for (size_t k = 0; k < count; ++k)
+                            ++streamSamples[static_cast<size_t>(i)][static_cast<int>(batch[k].stream)];
+
+                    if (verboseLogging) {
+                        for (size_t k = 0; k < count; ++k) {
+                            const auto& s = batch[k];
+                            if (s.stream == SensorStream::Euler)
+                                juce::Logger::writeToLog(juce::String::formatted(
+                                    "/euler/%d %f %f %f %f", i, s.values[0], s.values[1], s.values[2], s.values[3]));
+                        }
+                    }
 
-                c->update();
+                    // Filter per route; samples no route wants are never encoded.
+                    std::fill_n(emitted.begin(), count, false);
+                    for (auto& route : routing.all()) {
+                        if (!route.wantsSensor(i))
+                            continue;
+                        if (route.passesAll()) {
+                            sendOnRoute(route, i, batch.data(), count);
+                            std::fill_n(emitted.begin(), count, true);
+                            continue;
+                        }
+                        size_t n = 0;
+                        for (size_t k = 0; k < count; ++k) {
+                            if (route.accept(i, batch[k])) {
+                                routed[n++] = batch[k];
+                                emitted[k] = true;
+                            }
+                        }
+                        if (n > 0)
+                            sendOnRoute(route, i, routed.data(), n);
+                    }
 
-                const float* e = c->outputEuler;        // heading/yaw, pitch, roll, yaw/heading
-                const float* a = c->outputAcceleration;
-                const float* g = c->outputGyro;
-                const float* m = c->outputMag;
+                    // Only samples that went out are traced: those dropped by
+                    // decimation or dead-band on every route never reached
+                    // the wire.
+                    if (latencyReportMs > 0) {
+                        if (bundleMode == BundleMode::AllSensors) {
+                            for (size_t k = 0; k < count; ++k)
+                                if (emitted[k] && pendingTraces.size() < kMaxPendingTraces)
+                                    pendingTraces.emplace_back(i, batch[k]);
+                        } else {
+                            const int64_t sentNs = latency::nowNs();
+                            for (size_t k = 0; k < count; ++k)
+                                if (emitted[k])
+                                    traceSent(i, batch[k], sentNs);
+                        }
+                    }
+                }
+            }
 
-                sendOSC(juce::String::formatted("/euler/%d", i), {e[0], e[1], e[2], e[3]});
-                sendOSC(juce::String::formatted("/acc/%d",   i), {a[0], a[1], a[2]});
-                sendOSC(juce::String::formatted("/gyro/%d",  i), {g[0], g[1], g[2]});
-                sendOSC(juce::String::formatted("/mag/%d",   i), {m[0], m[1], m[2]});
+            // One commit (and at most one wake-up) per pass for local readers.
+            if (shm.enabled())
+                shm.commit();
+
+            const int64_t now = latency::nowNs();
+
+            // Stage output honours each route's sensor and stream filters.
+            if (orientation.enabled())
+                orientation.flush(stageSink);
+            if (aligner.enabled())
+                aligner.tick(now, stageSink);
+            if (filters.enabled())
+                filters.tick(now, stageSink);
+            if (features.enabled())
+                features.tick(now, stageSink);
+
+            // Resend held values that have gone quiet (dead-band / keep-alive).
+            for (auto& route : routing.all())
+                route.keepAlive(now, [&](int sensor, const SensorSample& s) { sendOnRoute(route, sensor, &s, 1); });
+
+            if (bundleMode == BundleMode::AllSensors) {
+                for (auto& route : routing.all())
+                    flushRigBundle(route);
+                const int64_t sentNs = latency::nowNs();
+                for (const auto& trace : pendingTraces)
+                    traceSent(trace.first, trace.second, sentNs);
+                pendingTraces.clear();
+            }
+
+            if (statsIntervalMs > 0)
+                logStats(lastStatsReport, lastStatsCpu);
 
-                if (verboseLogging)
-                    juce::Logger::writeToLog(juce::String::formatted(
-                        "/euler/%d %f %f %f %f", i, e[0], e[1], e[2], e[3]));
+            if (latencyReportMs > 0
+                && std::chrono::steady_clock::now() - lastLatencyReport
+                       >= std::chrono::milliseconds(latencyReportMs)) {
+                reportLatency();
+                lastLatencyReport = std::chrono::steady_clock::now();
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (linkCheckMs > 0
+                && std::chrono::steady_clock::now() - lastLinkCheck >= std::chrono::milliseconds(linkCheckMs)) {
+                checkLinkRates();
+                lastLinkCheck = std::chrono::steady_clock::now();
+            }
         }
+
+        // Closed here, on the only thread that writes to it, so local readers
+        // see the end of the stream.
+        shm.close();
     }
 
+    // Stops the streaming thread, then tears down what it was using: the
+    // recorder, the controllers its sample queues point into, and the fanout.
     void shutdown() {
         juce::Logger::writeToLog("Shutting down MetaOSC...");
         try {
-            for (auto& sender : oscSenders)
-                sender->disconnect();
+            // Stop recovery first so nothing reconnects a sensor being torn down.
+            supervisor.reset();
+
+            signalThreadShouldExit();
+            sampleAvailable.signal();
+            if (!stopThread(5000)) {
+                juce::Logger::writeToLog("Warning: Thread did not stop gracefully, forcing stop...");
+                stopThread(1000);
+            }
 
+            replay.stop();
+            recorder.close();
+
+            // Connected boards get a clean disconnect; the rest (still
+            // initialising, or failed) are detached from their transport the
+            // same way a lost link is, so no late callback reaches them.
             for (int i = 0; i < controllers.size(); ++i) {
                 auto* c = controllers[i];
-                if (c && c->isConnected)
+                if (c == nullptr)
+                    continue;
+                if (c->isConnected)
                     c->disconnectDevice(c->board);
+                else
+                    c->release_link();
             }
 
             controllers.clear();
 
-            if (!bleInterface.adapters.empty())
-                bleInterface.exit(bleInterface.adapters[0]);
+            fanout.stop();
+
+            for (auto& adapter : bleInterface.adapters)
+                bleInterface.exit(adapter);
 
             juce::Logger::writeToLog("MetaOSC shutdown complete.");
         } catch (const std::exception& e) {
@@ -157,14 +760,22 @@ int main(int argc, char* argv[]) {
         ]
     })");
 
-    // Parse command-line arguments: -c/--config <path>, -q/--quiet
+    // Parse command-line arguments: -c/--config <path>, -q/--quiet,
+    // --record <file>, --replay <file>, --replay-fast
     juce::String configPath;
+    SessionOptions session;
     for (int i = 1; i < argc; ++i) {
         juce::String arg(argv[i]);
         if ((arg == "--config" || arg == "-c") && i + 1 < argc) {
             configPath = argv[++i];
         } else if (arg == "--quiet" || arg == "-q") {
             verboseLogging = false;
+        } else if (arg == "--record" && i + 1 < argc) {
+            session.recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            session.replayPath = argv[++i];
+        } else if (arg == "--replay-fast") {
+            session.replayFast = true;
         }
     }
 
@@ -182,7 +793,7 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    MetaOSCThread metaOSCThread(config, verboseLogging);
+    MetaOSCThread metaOSCThread(config, verboseLogging, session);
 
     if (!metaOSCThread.startThread()) {
         juce::Logger::writeToLog("Failed to start MetaOSC thread!");
@@ -195,11 +806,6 @@ int main(int argc, char* argv[]) {
 
     metaOSCThread.shutdown();
 
-    if (!metaOSCThread.stopThread(5000)) {
-        juce::Logger::writeToLog("Warning: Thread did not stop gracefully, forcing stop...");
-        metaOSCThread.stopThread(1000);
-    }
-
     juce::Logger::writeToLog("Application terminated gracefully.");
     return 0;
 }
@@ -11,26 +11,33 @@
 // Construction / destruction
 // ---------------------------------------------------------------------------
 
-MetaMotionController::MetaMotionController(SimpleBLE::Peripheral& peripheralIn)
-    : peripheral(peripheralIn)
+MetaMotionController::MetaMotionController(std::unique_ptr<BleTransport> transportIn)
+    : address(transportIn->address()),
+      transport(std::move(transportIn))
 {
-    resetOrientation();
+    ready = readyPromise.get_future().share();
 }
 
 MetaMotionController::~MetaMotionController() {
     if (isConnected)
         disconnectDevice(board);
+    else if (board)
+        release_link();   // detach callbacks and free a half-initialised board
 }
 
 // ---------------------------------------------------------------------------
-// Setup – connects the MetaWear C SDK to our BLE peripheral via callbacks
+// Setup – connects the MetaWear C SDK to our BLE transport via callbacks
 // ---------------------------------------------------------------------------
 
 bool MetaMotionController::setup() {
-    if (!peripheral.is_connected())
+    if (!transport->isConnected())
         isConnected = false;
+    {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        callbacksOpen = true;
+    }
 
-    // Wire the MetaWear SDK's GATT operations to our SimpleBLE peripheral.
+    // Wire the MetaWear SDK's GATT operations to our transport.
     MblMwBtleConnection btleConnection;
     btleConnection.context              = this;
     btleConnection.write_gatt_char      = write_gatt_char;
@@ -39,47 +46,162 @@ bool MetaMotionController::setup() {
     btleConnection.on_disconnect        = on_disconnect;
     board = mbl_mw_metawearboard_create(&btleConnection);
 
-    // Asynchronously initialise the board; the lambda is called when done.
+    // On reconnect, restore the saved module info so initialisation skips
+    // service discovery.
+    if (!boardState.empty())
+        mbl_mw_metawearboard_deserialize(board, boardState.data(), static_cast<uint32_t>(boardState.size()));
+
+    transport->onDisconnected([this] {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        if (!callbacksOpen)
+            return;
+        linkDropped = true;
+        if (disconnectHandler)
+            disconnectHandler(disconnectCaller, MBL_MW_STATUS_OK);
+    });
+
+    // Initialisation runs as a chain of SDK completion callbacks:
+    //   Initializing -> ConfiguringFusion -> CreatingProcessors -> Subscribing
+    //   -> WaitingForData -> Streaming
+    advance_init(InitState::Idle, InitState::Initializing);
+
     mbl_mw_metawearboard_initialize(board, this, [](void* context, MblMwMetaWearBoard* board, int32_t status) {
         // MetaWear SDK: status == MBL_MW_STATUS_OK (0) means success.
+        auto* self = static_cast<MetaMotionController*>(context);
         if (status != MBL_MW_STATUS_OK) {
             printf("Error initializing board: %d\n", status);
+            self->fail_init("board initialisation error");
             return;
         }
+        if (!self->advance_init(InitState::Initializing, InitState::ConfiguringFusion))
+            return;
         printf("Board initialized\n");
 
-        // Spin-wait for the async init to complete (SDK requirement).
-        while (!mbl_mw_metawearboard_is_initialized(board)) {}
-
         auto dev_info = mbl_mw_metawearboard_get_device_information(board);
         printf("Firmware: %s  Model: %s (%s)\n",
                dev_info->firmware_revision,
                dev_info->model_number,
                mbl_mw_metawearboard_get_model_name(board));
 
-        auto* self = static_cast<MetaMotionController*>(context);
-        self->enable_fusion_sampling(board);
-        self->get_current_power_status(board);
-        self->get_battery_percentage(board);
-        self->get_ad_name(board);
-        self->isConnected = true;
+        if (self->sensorConfig.rawImu) {
+            // Raw IMU mode has no config read-back; subscribe right away.
+            self->configure_raw_imu(board);
+            if (self->advance_init(InitState::ConfiguringFusion, InitState::Subscribing))
+                self->start_streaming(board);
+            return;
+        }
+
+        // Write the fusion config, then read it back; the read completes once
+        // the board has processed the write.
+        self->configure_sensor_fusion(board);
+        mbl_mw_sensor_fusion_read_config(board, self, [](void* context, MblMwMetaWearBoard* board, int32_t status) {
+            auto* self = static_cast<MetaMotionController*>(context);
+            if (status != MBL_MW_STATUS_OK) {
+                printf("Error configuring sensor fusion: %d\n", status);
+                self->fail_init("sensor fusion configuration error");
+                return;
+            }
+            if (self->advance_init(InitState::ConfiguringFusion, InitState::CreatingProcessors))
+                self->create_onboard_processors(board);
+        });
     });
 
     return true;
 }
 
+// Subscribing step: tune the link, start the configured data source and
+// query board status.
+void MetaMotionController::start_streaming(MblMwMetaWearBoard* board) {
+    apply_connection_parameters(board);
+    if (sensorConfig.rawImu)
+        enable_raw_imu_sampling(board);
+    else
+        enable_fusion_sampling(board);
+    get_current_power_status(board);
+    get_battery_percentage(board);
+    get_ad_name(board);
+
+    // The first published sample completes initialisation.
+    advance_init(InitState::Subscribing, InitState::WaitingForData);
+}
+
 // ---------------------------------------------------------------------------
-// Per-frame update
+// Initialisation state machine helpers
 // ---------------------------------------------------------------------------
 
-void MetaMotionController::update() {
-    if (!peripheral.is_connected())
+int64_t MetaMotionController::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int MetaMotionController::step_timeout_ms(InitState step) {
+    switch (step) {
+        case InitState::Initializing:      return 8000;   // service discovery + module info
+        case InitState::ConfiguringFusion: return 2000;
+        case InitState::CreatingProcessors: return 5000;  // one round trip per processor
+        case InitState::Subscribing:       return 2000;
+        case InitState::WaitingForData:    return 3000;   // fusion runs at up to 100 Hz
+        default:                           return 0;      // not a timed step
+    }
+}
+
+bool MetaMotionController::advance_init(InitState from, InitState to) {
+    if (!state.compare_exchange_strong(from, to))
+        return false;
+
+    const int64_t now = now_ns();
+    if (from != InitState::Idle)
+        stepDurationMs[static_cast<int>(from)] = (now - stepStartNs.load()) / 1000000;
+    stepStartNs.store(now);
+
+    if (to == InitState::Streaming) {
+        printf("[%s] init timings: init %lld ms, configure %lld ms, processors %lld ms, subscribe %lld ms, first sample %lld ms\n",
+               address.c_str(),
+               (long long)stepDurationMs[static_cast<int>(InitState::Initializing)],
+               (long long)stepDurationMs[static_cast<int>(InitState::ConfiguringFusion)],
+               (long long)stepDurationMs[static_cast<int>(InitState::CreatingProcessors)],
+               (long long)stepDurationMs[static_cast<int>(InitState::Subscribing)],
+               (long long)stepDurationMs[static_cast<int>(InitState::WaitingForData)]);
+        save_board_state();
+        isConnected = true;
+        signal_ready(true);
+    }
+    return true;
+}
+
+void MetaMotionController::save_board_state() {
+    uint32_t size = 0;
+    uint8_t* state = mbl_mw_metawearboard_serialize(board, &size);
+    if (state == nullptr)
+        return;
+    boardState.assign(state, state + size);
+    mbl_mw_memory_free(state);
+}
+
+void MetaMotionController::fail_init(const char* reason) {
+    InitState current = state.load();
+    while (current != InitState::Streaming && current != InitState::Failed) {
+        if (state.compare_exchange_weak(current, InitState::Failed)) {
+            printf("[%s] initialisation failed: %s\n", address.c_str(), reason);
+            signal_ready(false);
+            return;
+        }
+    }
+}
+
+void MetaMotionController::poll_init_timeout() {
+    const InitState current = state.load();
+    const int timeoutMs = step_timeout_ms(current);
+    if (timeoutMs == 0)
         return;
+    if (now_ns() - stepStartNs.load() > static_cast<int64_t>(timeoutMs) * 1000000)
+        fail_init("step timed out");
+}
 
-    // Select heading source based on whether magnetometer correction is used.
-    angle[0] = bUseMagnoHeading ? outputEuler[0] : outputEuler[3];
-    angle[1] = outputEuler[1];
-    angle[2] = outputEuler[2];
+// Fulfils `ready` exactly once; later calls are ignored.
+void MetaMotionController::signal_ready(bool success) {
+    if (!readySignalled.exchange(true))
+        readyPromise.set_value(success);
 }
 
 // ---------------------------------------------------------------------------
@@ -89,21 +211,154 @@ void MetaMotionController::update() {
 void MetaMotionController::disconnectDevice(MblMwMetaWearBoard* board) {
     if (isConnected) {
         disable_led(board);
+        remove_onboard_processors();
+        close_callbacks();
+        detach_disconnect_handler();
+        // Stop notifications before the board they are routed to is freed.
+        try {
+            transport->disconnect();
+        } catch (const std::exception& e) {
+            std::cout << "Disconnect failed: " << e.what() << std::endl;
+        }
         mbl_mw_metawearboard_free(board);
+        this->board = nullptr;   // so release_link() does not free it again
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
     isConnected = false;
 }
 
+// Waits for any notify or disconnect callback in flight and turns away later
+// ones, so the board, transport and frame can be torn down underneath them.
+void MetaMotionController::close_callbacks() {
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    callbacksOpen = false;
+}
+
+// ---------------------------------------------------------------------------
+// Reconnection
+// ---------------------------------------------------------------------------
+
+bool MetaMotionController::link_lost(int silenceMs) {
+    const InitState current = state.load();
+    if (current == InitState::Failed)
+        return true;
+    if (current != InitState::Streaming)
+        return false;   // still initialising
+    if (linkDropped.load() || !transport->isConnected())
+        return true;
+    return silenceMs > 0
+        && now_ns() - lastNotifyNs.load(std::memory_order_relaxed) > static_cast<int64_t>(silenceMs) * 1000000;
+}
+
+void MetaMotionController::release_link() {
+    isConnected = false;
+    close_callbacks();
+    detach_disconnect_handler();
+    try {
+        transport->disconnect();
+    } catch (const std::exception& e) {
+        // Usually the link is already gone.
+        std::cout << "[" << address << "] disconnect: " << e.what() << std::endl;
+    }
+    // The chains stay on the board. Their ids are in the saved board state,
+    // so create_onboard_processors() can look them up and remove them on
+    // reconnect.
+    for (int i = 0; i < kNumSensorStreams; ++i) {
+        if (onboardHead[i])
+            staleProcessors.push_back(mbl_mw_dataprocessor_get_id(onboardHead[i]));
+        onboardHead[i]   = nullptr;
+        onboardSignal[i] = nullptr;
+    }
+    if (board) {
+        mbl_mw_metawearboard_free(board);
+        board = nullptr;
+    }
+}
+
+void MetaMotionController::prepare_reconnect(std::unique_ptr<BleTransport> newTransport) {
+    if (newTransport)
+        transport = std::move(newTransport);
+
+    linkDropped       = false;
+    disconnectHandler = nullptr;
+    disconnectCaller  = nullptr;
+    for (auto& position : packedPosition)
+        position = PackedPosition{};
+    onboardCursor = OnboardCursor{};
+
+    readyPromise   = std::promise<bool>();
+    ready          = readyPromise.get_future().share();
+    readySignalled = false;
+    state.store(InitState::Idle);
+}
+
 // ---------------------------------------------------------------------------
 // Sensor fusion configuration
 // ---------------------------------------------------------------------------
 
+// Fusion outputs the controller can stream, each with the SensorStream it
+// feeds and a data handler that converts the SDK value to floats.
+namespace {
+
+struct FusionOutput {
+    SensorStream          stream;
+    MblMwSensorFusionData data;
+    MblMwFnData           handler;
+};
+
+// Corrected (acc, gyro, mag) and plain (linear acc) cartesian values.
+template <SensorStream Stream, typename Value>
+void publish_cartesian(void* context, const MblMwData* data) {
+    auto* v = static_cast<const Value*>(data->value);
+    const float values[3] = { v->x, v->y, v->z };
+    static_cast<MetaMotionController*>(context)->publish_sample(Stream, data->epoch, values, 3);
+}
+
+void publish_euler(void* context, const MblMwData* data) {
+    auto* self  = static_cast<MetaMotionController*>(context);
+    auto* euler = static_cast<MblMwEulerAngles*>(data->value);
+    // Store heading and yaw in positions 0/3 depending on the magno flag.
+    const float values[4] = {
+        self->bUseMagnoHeading ? euler->heading : euler->yaw,
+        euler->pitch,
+        euler->roll,
+        self->bUseMagnoHeading ? euler->yaw : euler->heading
+    };
+    self->publish_sample(SensorStream::Euler, data->epoch, values, 4);
+}
+
+void publish_quaternion(void* context, const MblMwData* data) {
+    auto* q = static_cast<MblMwQuaternion*>(data->value);
+    const float values[4] = { q->w, q->x, q->y, q->z };
+    static_cast<MetaMotionController*>(context)->publish_sample(SensorStream::Quat, data->epoch, values, 4);
+}
+
+const FusionOutput kFusionOutputs[] = {
+    { SensorStream::Euler,  MBL_MW_SENSOR_FUSION_DATA_EULER_ANGLE,    publish_euler },
+    { SensorStream::Acc,    MBL_MW_SENSOR_FUSION_DATA_CORRECTED_ACC,  publish_cartesian<SensorStream::Acc, MblMwCorrectedCartesianFloat> },
+    { SensorStream::Gyro,   MBL_MW_SENSOR_FUSION_DATA_CORRECTED_GYRO, publish_cartesian<SensorStream::Gyro, MblMwCorrectedCartesianFloat> },
+    { SensorStream::Mag,    MBL_MW_SENSOR_FUSION_DATA_CORRECTED_MAG,  publish_cartesian<SensorStream::Mag, MblMwCorrectedCartesianFloat> },
+    { SensorStream::Quat,   MBL_MW_SENSOR_FUSION_DATA_QUATERNION,     publish_quaternion },
+    { SensorStream::LinAcc, MBL_MW_SENSOR_FUSION_DATA_LINEAR_ACC,     publish_cartesian<SensorStream::LinAcc, MblMwCartesianFloat> },
+};
+
+MblMwDataSignal* fusion_signal(MblMwMetaWearBoard* board, SensorStream stream) {
+    for (const auto& output : kFusionOutputs)
+        if (output.stream == stream)
+            return mbl_mw_sensor_fusion_get_data_signal(board, output.data);
+    return nullptr;
+}
+
+} // namespace
+
+// sensorConfig is read-only from here on: the streaming thread reads its
+// outputs for the link-rate check while a re-init runs. Outputs the mode does
+// not produce were already dropped by SensorConfig::forAddress().
 void MetaMotionController::configure_sensor_fusion(MblMwMetaWearBoard* board) {
-    // NDOF = 9-DoF fusion using accelerometer, gyro, and magnetometer.
-    mbl_mw_sensor_fusion_set_mode(board, MBL_MW_SENSOR_FUSION_MODE_NDOF);
-    mbl_mw_sensor_fusion_set_acc_range(board, MBL_MW_SENSOR_FUSION_ACC_RANGE_4G);
-    mbl_mw_sensor_fusion_set_gyro_range(board, MBL_MW_SENSOR_FUSION_GYRO_RANGE_2000DPS);
+    const auto& config = sensorConfig;
+    mbl_mw_sensor_fusion_set_mode(board, config.fusionMode);
+    mbl_mw_sensor_fusion_set_acc_range(board, config.accRange);
+    mbl_mw_sensor_fusion_set_gyro_range(board, config.gyroRange);
     mbl_mw_sensor_fusion_write_config(board);
 
     // MetaMotion S supports a higher TX power level.
@@ -111,73 +366,367 @@ void MetaMotionController::configure_sensor_fusion(MblMwMetaWearBoard* board) {
     mbl_mw_settings_set_tx_power(board, isMMSModel ? 8 : 4);
 }
 
+// Expects configure_sensor_fusion() to have been applied already. Only the
+// outputs enabled in sensorConfig are subscribed and turned on, so disabled
+// streams never go over the air.
 void MetaMotionController::enable_fusion_sampling(MblMwMetaWearBoard* board) {
     if (!board) return;
 
-    configure_sensor_fusion(board);
+    for (const auto& output : kFusionOutputs) {
+        if (!sensorConfig.enabled(output.stream))
+            continue;
+        // An on-board chain delivers the same data type as its source.
+        auto* chain  = onboardSignal[static_cast<int>(output.stream)];
+        auto* signal = chain ? chain : mbl_mw_sensor_fusion_get_data_signal(board, output.data);
+        mbl_mw_datasignal_subscribe(signal, this, output.handler);
+        mbl_mw_sensor_fusion_enable_data(board, output.data);
+    }
+    mbl_mw_sensor_fusion_start(board);
 
-    // Subscribe to Euler angles (heading, pitch, roll, yaw).
-    auto euler_signal = mbl_mw_sensor_fusion_get_data_signal(board, MBL_MW_SENSOR_FUSION_DATA_EULER_ANGLE);
-    mbl_mw_datasignal_subscribe(euler_signal, this, [](void* context, const MblMwData* data) {
-        auto* self  = static_cast<MetaMotionController*>(context);
-        auto* euler = static_cast<MblMwEulerAngles*>(data->value);
-        // Store heading and yaw in positions 0/3 depending on the magno flag.
-        if (self->bUseMagnoHeading) {
-            self->outputEuler[0] = euler->heading;
-            self->outputEuler[3] = euler->yaw;
+    enable_led(board);
+}
+
+void MetaMotionController::disable_fusion_sampling(MblMwMetaWearBoard* board) {
+    if (!board) return;
+    mbl_mw_sensor_fusion_stop(board);
+    for (const auto& output : kFusionOutputs) {
+        if (!sensorConfig.enabled(output.stream))
+            continue;
+        auto* chain = onboardSignal[static_cast<int>(output.stream)];
+        mbl_mw_datasignal_unsubscribe(chain ? chain : mbl_mw_sensor_fusion_get_data_signal(board, output.data));
+    }
+    mbl_mw_sensor_fusion_clear_enabled_mask(board);
+}
+
+// ---------------------------------------------------------------------------
+// On-board data processing
+// ---------------------------------------------------------------------------
+
+void MetaMotionController::create_onboard_processors(MblMwMetaWearBoard* board) {
+    for (int i = 0; i < kNumSensorStreams; ++i) {
+        onboardHead[i]   = nullptr;
+        onboardSignal[i] = nullptr;
+    }
+    // Remove the chains a lost link left behind, which would otherwise keep
+    // running and fill the board's processor slots. Only our own chains:
+    // loggers, events and other processors on the board are left alone.
+    for (const uint8_t id : staleProcessors)
+        if (auto* processor = mbl_mw_dataprocessor_lookup_id(board, id))
+            mbl_mw_dataprocessor_remove(processor);
+    staleProcessors.clear();
+
+    onboardCursor = OnboardCursor{};
+    create_next_processor(board);
+}
+
+void MetaMotionController::create_next_processor(MblMwMetaWearBoard* board) {
+    for (; onboardCursor.stream < kNumSensorStreams; ++onboardCursor.stream, onboardCursor.stage = 0) {
+        const int i = onboardCursor.stream;
+        const auto stream = static_cast<SensorStream>(i);
+        const auto& chain = sensorConfig.onboard[i];
+        if (!sensorConfig.enabled(stream) || !chain.any())
+            continue;
+
+        MblMwDataSignal* tail = onboardSignal[i] ? onboardSignal[i] : fusion_signal(board, stream);
+        while (onboardCursor.stage < 3 && tail) {
+            int32_t status;
+            switch (onboardCursor.stage++) {
+                case 0:
+                    if (chain.averageSize == 0) continue;
+                    status = mbl_mw_dataprocessor_average_create(tail, chain.averageSize, this, on_processor_created);
+                    break;
+                case 1:
+                    if (chain.delta <= 0.0f) continue;
+                    status = mbl_mw_dataprocessor_delta_create(tail, MBL_MW_DELTA_MODE_ABSOLUTE, chain.delta,
+                                                               this, on_processor_created);
+                    break;
+                default:
+                    if (chain.periodMs == 0) continue;
+                    status = mbl_mw_dataprocessor_time_create(tail, MBL_MW_TIME_ABSOLUTE, chain.periodMs,
+                                                              this, on_processor_created);
+                    break;
+            }
+            if (status == MBL_MW_STATUS_OK)
+                return;   // continues in on_processor_created()
+            abandon_chain("not supported for this output");
+        }
+    }
+
+    if (advance_init(InitState::CreatingProcessors, InitState::Subscribing))
+        start_streaming(board);
+}
+
+void MetaMotionController::on_processor_created(void* context, MblMwDataProcessor* processor) {
+    auto* self = static_cast<MetaMotionController*>(context);
+    if (self->state.load() != InitState::CreatingProcessors)
+        return;   // the step timed out meanwhile
+
+    const int i = self->onboardCursor.stream;
+    if (processor == nullptr) {
+        self->abandon_chain("creation failed");
+    } else {
+        if (self->onboardHead[i] == nullptr)
+            self->onboardHead[i] = processor;
+        self->onboardSignal[i] = processor;
+    }
+    self->create_next_processor(self->board);
+}
+
+void MetaMotionController::abandon_chain(const char* reason) {
+    const int i = onboardCursor.stream;
+    printf("[%s] on-board %s chain %s, streaming the plain fusion output\n",
+           address.c_str(), streamAddressPrefix(static_cast<SensorStream>(i)) + 1, reason);
+    if (onboardHead[i])
+        mbl_mw_dataprocessor_remove(onboardHead[i]);
+    onboardHead[i]      = nullptr;
+    onboardSignal[i]    = nullptr;
+    onboardCursor.stage = 3;   // skip the rest of this chain
+}
+
+void MetaMotionController::remove_onboard_processors() {
+    for (int i = 0; i < kNumSensorStreams; ++i) {
+        if (onboardHead[i])
+            mbl_mw_dataprocessor_remove(onboardHead[i]);
+        onboardHead[i]   = nullptr;
+        onboardSignal[i] = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BLE connection parameters and link throughput
+// ---------------------------------------------------------------------------
+
+void MetaMotionController::apply_connection_parameters(MblMwMetaWearBoard* board) {
+    ConnectionParams params = sensorConfig.connection;
+    if (!params.requested()) {
+        if (!sensorConfig.rawImu)
+            return;   // fusion at 100 Hz is fine with the central's default
+        // Shortest interval: at 400-800 Hz the packed signals need roughly
+        // one notification per connection event.
+        params.minIntervalMs = params.maxIntervalMs = 7.5f;
+    }
+
+    // A central schedules every connection inside the same radio time; with
+    // many sensors on one adapter, short intervals just cause missed events.
+    if (params.autoBackoff && sensorsOnAdapter > params.backoffSensors) {
+        const float scale = static_cast<float>(sensorsOnAdapter) / static_cast<float>(params.backoffSensors);
+        params.minIntervalMs = std::min(params.minIntervalMs * scale, 4000.0f);
+        params.maxIntervalMs = std::min(std::max(params.maxIntervalMs * scale, params.minIntervalMs), 4000.0f);
+    }
+
+    mbl_mw_settings_set_connection_parameters(board, params.minIntervalMs, params.maxIntervalMs,
+                                              params.latency, params.timeoutMs);
+    printf("[%s] connection interval %.2f-%.2f ms, latency %u, timeout %u ms (%d sensor(s) on adapter)\n",
+           address.c_str(), params.minIntervalMs, params.maxIntervalMs,
+           (unsigned)params.latency, (unsigned)params.timeoutMs, sensorsOnAdapter);
+}
+
+// Notifications per second the enabled outputs should produce: one per
+// fusion sample, or one per three raw readings for packed signals.
+double MetaMotionController::expected_notification_rate() const {
+    const auto& config = sensorConfig;
+    if (config.rawImu) {
+        const int streams = (config.enabled(SensorStream::Acc) ? 1 : 0)
+                          + (config.enabled(SensorStream::Gyro) ? 1 : 0);
+        return streams * config.rawOdrHz / 3.0;
+    }
+
+    double fusionHz = 100.0;
+    if (config.fusionMode == MBL_MW_SENSOR_FUSION_MODE_COMPASS) fusionHz = 25.0;
+    if (config.fusionMode == MBL_MW_SENSOR_FUSION_MODE_M4G)     fusionHz = 50.0;
+    double total = 0.0;
+    for (int s = 0; s < kNumSensorStreams; ++s) {
+        if (!config.enabled(static_cast<SensorStream>(s)))
+            continue;
+        const auto& chain = config.onboard[s];
+        if (chain.delta > 0.0f)
+            continue;   // data dependent: nothing to expect
+        total += chain.periodMs > 0 ? std::min(fusionHz, 1000.0 / chain.periodMs) : fusionHz;
+    }
+    return total;
+}
+
+MetaMotionController::LinkRate MetaMotionController::measure_link_rate() {
+    LinkRate rate;
+    const int64_t  now   = now_ns();
+    const uint64_t count = notificationCount.load(std::memory_order_relaxed);
+    if (lastLinkNs != 0 && now > lastLinkNs) {
+        rate.notificationsHz = static_cast<double>(count - lastLinkCount) * 1e9 / static_cast<double>(now - lastLinkNs);
+        rate.expectedHz      = expected_notification_rate();
+    }
+    lastLinkCount = count;
+    lastLinkNs    = now;
+    return rate;
+}
+
+// ---------------------------------------------------------------------------
+// Raw IMU streaming (packed accelerometer and gyro signals)
+// ---------------------------------------------------------------------------
+
+namespace {
+
+constexpr int kPackedSamples = 3;   // readings per packed notification
+
+// Gyro output data rates supported by the BMI160/BMI270 driver.
+MblMwGyroBoschOdr gyro_odr_for(float hz) {
+    static const struct { float hz; MblMwGyroBoschOdr odr; } kRates[] = {
+        { 25.0f,   MBL_MW_GYRO_BOSCH_ODR_25Hz },   { 50.0f,   MBL_MW_GYRO_BOSCH_ODR_50Hz },
+        { 100.0f,  MBL_MW_GYRO_BOSCH_ODR_100Hz },  { 200.0f,  MBL_MW_GYRO_BOSCH_ODR_200Hz },
+        { 400.0f,  MBL_MW_GYRO_BOSCH_ODR_400Hz },  { 800.0f,  MBL_MW_GYRO_BOSCH_ODR_800Hz },
+        { 1600.0f, MBL_MW_GYRO_BOSCH_ODR_1600Hz },
+    };
+    for (const auto& rate : kRates)
+        if (hz <= rate.hz)
+            return rate.odr;
+    return MBL_MW_GYRO_BOSCH_ODR_1600Hz;
+}
+
+MblMwGyroBoschRange gyro_range_for(int dps) {
+    switch (dps) {
+        case 250:  return MBL_MW_GYRO_BOSCH_RANGE_250dps;
+        case 500:  return MBL_MW_GYRO_BOSCH_RANGE_500dps;
+        case 1000: return MBL_MW_GYRO_BOSCH_RANGE_1000dps;
+        default:   return MBL_MW_GYRO_BOSCH_RANGE_2000dps;
+    }
+}
+
+template <SensorStream Stream>
+void publish_packed(void* context, const MblMwData* data) {
+    auto* self = static_cast<MetaMotionController*>(context);
+    auto* v    = static_cast<const MblMwCartesianFloat*>(data->value);
+    const float values[3] = { v->x, v->y, v->z };
+    self->publish_sample(Stream, self->unpack_epoch(Stream, data->epoch), values, 3);
+}
+
+} // namespace
+
+void MetaMotionController::configure_raw_imu(MblMwMetaWearBoard* board) {
+    const auto& config = sensorConfig;
+    gyroIsBmi270 = mbl_mw_metawearboard_lookup_module(board, MBL_MW_MODULE_GYRO)
+                   == MBL_MW_MODULE_GYRO_TYPE_BMI270;
+
+    if (config.enabled(SensorStream::Acc)) {
+        mbl_mw_acc_set_odr(board, config.rawOdrHz);
+        mbl_mw_acc_set_range(board, static_cast<float>(config.accRangeG));
+        mbl_mw_acc_write_acceleration_config(board);
+    }
+
+    if (config.enabled(SensorStream::Gyro)) {
+        // MetaMotion R/RL carry a BMI160, MetaMotion S a BMI270.
+        if (gyroIsBmi270) {
+            mbl_mw_gyro_bmi270_set_odr(board, gyro_odr_for(config.rawOdrHz));
+            mbl_mw_gyro_bmi270_set_range(board, gyro_range_for(config.gyroRangeDps));
+            mbl_mw_gyro_bmi270_write_config(board);
         } else {
-            self->outputEuler[0] = euler->yaw;
-            self->outputEuler[3] = euler->heading;
+            mbl_mw_gyro_bmi160_set_odr(board, gyro_odr_for(config.rawOdrHz));
+            mbl_mw_gyro_bmi160_set_range(board, gyro_range_for(config.gyroRangeDps));
+            mbl_mw_gyro_bmi160_write_config(board);
         }
-        self->outputEuler[1] = euler->pitch;
-        self->outputEuler[2] = euler->roll;
-    });
+    }
 
-    // Subscribe to corrected acceleration.
-    auto acc_signal = mbl_mw_sensor_fusion_get_data_signal(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_ACC);
-    mbl_mw_datasignal_subscribe(acc_signal, this, [](void* context, const MblMwData* data) {
-        auto* self = static_cast<MetaMotionController*>(context);
-        auto* acc  = static_cast<MblMwCorrectedCartesianFloat*>(data->value);
-        self->outputAcceleration[0] = acc->x;
-        self->outputAcceleration[1] = acc->y;
-        self->outputAcceleration[2] = acc->z;
-    });
+    bool isMMSModel = (mbl_mw_metawearboard_get_model(board) == MBL_MW_MODEL_METAMOTION_S);
+    mbl_mw_settings_set_tx_power(board, isMMSModel ? 8 : 4);
+}
 
-    // Subscribe to corrected gyroscope.
-    auto gyro_signal = mbl_mw_sensor_fusion_get_data_signal(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_GYRO);
-    mbl_mw_datasignal_subscribe(gyro_signal, this, [](void* context, const MblMwData* data) {
-        auto* self = static_cast<MetaMotionController*>(context);
-        auto* gyro = static_cast<MblMwCorrectedCartesianFloat*>(data->value);
-        self->outputGyro[0] = gyro->x;
-        self->outputGyro[1] = gyro->y;
-        self->outputGyro[2] = gyro->z;
-    });
+void MetaMotionController::enable_raw_imu_sampling(MblMwMetaWearBoard* board) {
+    if (!board) return;
 
-    // Subscribe to corrected magnetometer.
-    auto mag_signal = mbl_mw_sensor_fusion_get_data_signal(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_MAG);
-    mbl_mw_datasignal_subscribe(mag_signal, this, [](void* context, const MblMwData* data) {
-        auto* self = static_cast<MetaMotionController*>(context);
-        auto* mag  = static_cast<MblMwCorrectedCartesianFloat*>(data->value);
-        self->outputMag[0] = mag->x;
-        self->outputMag[1] = mag->y;
-        self->outputMag[2] = mag->z;
-    });
+    if (sensorConfig.enabled(SensorStream::Acc)) {
+        mbl_mw_datasignal_subscribe(mbl_mw_acc_get_packed_acceleration_data_signal(board),
+                                    this, publish_packed<SensorStream::Acc>);
+        mbl_mw_acc_enable_acceleration_sampling(board);
+        mbl_mw_acc_start(board);
+    }
 
-    // Enable all data streams and start fusion.
-    mbl_mw_sensor_fusion_enable_data(board, MBL_MW_SENSOR_FUSION_DATA_EULER_ANGLE);
-    mbl_mw_sensor_fusion_enable_data(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_ACC);
-    mbl_mw_sensor_fusion_enable_data(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_GYRO);
-    mbl_mw_sensor_fusion_enable_data(board, MBL_MW_SENSOR_FUSION_DATA_CORRECTED_MAG);
-    mbl_mw_sensor_fusion_start(board);
+    if (sensorConfig.enabled(SensorStream::Gyro)) {
+        if (gyroIsBmi270) {
+            mbl_mw_datasignal_subscribe(mbl_mw_gyro_bmi270_get_packed_rotation_data_signal(board),
+                                        this, publish_packed<SensorStream::Gyro>);
+            mbl_mw_gyro_bmi270_enable_rotation_sampling(board);
+            mbl_mw_gyro_bmi270_start(board);
+        } else {
+            mbl_mw_datasignal_subscribe(mbl_mw_gyro_bmi160_get_packed_rotation_data_signal(board),
+                                        this, publish_packed<SensorStream::Gyro>);
+            mbl_mw_gyro_bmi160_enable_rotation_sampling(board);
+            mbl_mw_gyro_bmi160_start(board);
+        }
+    }
 
     enable_led(board);
 }
 
-void MetaMotionController::disable_fusion_sampling(MblMwMetaWearBoard* board) {
+void MetaMotionController::disable_raw_imu_sampling(MblMwMetaWearBoard* board) {
     if (!board) return;
-    auto fusion_signal = mbl_mw_sensor_fusion_get_data_signal(board, MBL_MW_SENSOR_FUSION_DATA_EULER_ANGLE);
-    mbl_mw_datasignal_unsubscribe(fusion_signal);
-    mbl_mw_sensor_fusion_stop(board);
+
+    if (sensorConfig.enabled(SensorStream::Acc)) {
+        mbl_mw_acc_stop(board);
+        mbl_mw_acc_disable_acceleration_sampling(board);
+        mbl_mw_datasignal_unsubscribe(mbl_mw_acc_get_packed_acceleration_data_signal(board));
+    }
+
+    if (sensorConfig.enabled(SensorStream::Gyro)) {
+        if (gyroIsBmi270) {
+            mbl_mw_gyro_bmi270_stop(board);
+            mbl_mw_gyro_bmi270_disable_rotation_sampling(board);
+            mbl_mw_datasignal_unsubscribe(mbl_mw_gyro_bmi270_get_packed_rotation_data_signal(board));
+        } else {
+            mbl_mw_gyro_bmi160_stop(board);
+            mbl_mw_gyro_bmi160_disable_rotation_sampling(board);
+            mbl_mw_datasignal_unsubscribe(mbl_mw_gyro_bmi160_get_packed_rotation_data_signal(board));
+        }
+    }
+}
+
+int64_t MetaMotionController::unpack_epoch(SensorStream stream, int64_t epoch) {
+    auto& position = packedPosition[stream == SensorStream::Acc ? 0 : 1];
+    const int64_t notifyNs = lastNotifyNs.load(std::memory_order_relaxed);
+    if (notifyNs != position.notifyNs) {
+        position.notifyNs = notifyNs;
+        position.index    = 0;
+    } else if (position.index < kPackedSamples - 1) {
+        ++position.index;
+    }
+
+    // The last reading of a packet is the one that arrived with it.
+    const double periodMs = 1000.0 / sensorConfig.rawOdrHz;
+    return epoch - static_cast<int64_t>((kPackedSamples - 1 - position.index) * periodMs + 0.5);
+}
+
+// ---------------------------------------------------------------------------
+// Sample pipeline
+// ---------------------------------------------------------------------------
+
+void MetaMotionController::publish_sample(SensorStream stream, int64_t epoch,
+                                          const float* values, uint8_t numValues) {
+    const int64_t callbackNs = latency::nowNs();
+
+    if (state.load(std::memory_order_relaxed) == InitState::WaitingForData)
+        advance_init(InitState::WaitingForData, InitState::Streaming);
+
+    // Latest-value frame for snapshot() readers.
+    latestFrame.sequence++;
+    latestFrame.epoch = epoch;
+    latestFrame.streamEpoch[static_cast<int>(stream)] = epoch;
+    std::copy(values, values + numValues, latestFrame.values(stream));
+    frame.store(latestFrame);
+
+    // Timestamped sample for the streaming thread.
+    SensorSample sample;
+    sample.sequence  = latestFrame.sequence;
+    sample.epoch     = epoch;
+    sample.stream    = stream;
+    sample.numValues = numValues;
+    std::copy(values, values + numValues, sample.values);
+    sample.notifyNs   = lastNotifyNs.load(std::memory_order_relaxed);
+    sample.callbackNs = callbackNs;
+    sample.handoffNs  = latency::nowNs();
+
+    if (!samples.push(sample)) {
+        droppedSamples.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (onSampleAvailable)
+        onSampleAvailable();
 }
 
 // ---------------------------------------------------------------------------
@@ -251,38 +800,18 @@ void MetaMotionController::disable_led(MblMwMetaWearBoard* board) {
     mbl_mw_led_stop_and_clear(board);
 }
 
-// ---------------------------------------------------------------------------
-// Orientation helpers
-// ---------------------------------------------------------------------------
-
-void MetaMotionController::resetOrientation() {
-    std::fill(std::begin(angle_shift), std::end(angle_shift), 0.0f);
-}
-
-void MetaMotionController::recenter() {
-    // Make the current angle the new zero by negating it into angle_shift.
-    for (int i = 0; i < 3; ++i)
-        angle_shift[i] = -angle[i];
-}
-
-// Returns angle[] with angle_shift[] applied.
-std::array<float, 3> MetaMotionController::getAngle() {
-    return { angle[0] + angle_shift[0],
-             angle[1] + angle_shift[1],
-             angle[2] + angle_shift[2] };
-}
-
 // ---------------------------------------------------------------------------
 // GATT bridge helpers
 //
 // The MetaWear C SDK communicates with the sensor entirely via four callbacks:
 // read, write, notify, and disconnect. These static functions translate those
-// calls into SimpleBLE operations on our peripheral.
+// calls into operations on our BleTransport.
 //
 // UUIDs are stored as two 64-bit halves (high/low) in MblMwGattChar and must
 // be converted to the "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" string format
 // expected by SimpleBLE. Note: SimpleBLE lowercases UUIDs internally, so we
-// must use lowercase hex (%02x) here to match.
+// must use lowercase hex (%02x) here to match. The conversion runs once per
+// characteristic; resolve_char() caches the result.
 // ---------------------------------------------------------------------------
 
 static std::string HighLow2Uuid(uint64_t high, uint64_t low) {
@@ -296,14 +825,26 @@ static std::string HighLow2Uuid(uint64_t high, uint64_t low) {
     return uuid;
 }
 
+const MetaMotionController::GattCharUuids&
+MetaMotionController::resolve_char(const MblMwGattChar* characteristic) {
+    const GattCharKey key{ characteristic->uuid_high, characteristic->uuid_low };
+    std::lock_guard<std::mutex> lock(gattCharCacheMutex);
+    auto it = gattCharCache.find(key);
+    if (it == gattCharCache.end()) {
+        it = gattCharCache.emplace(key, GattCharUuids{
+            HighLow2Uuid(characteristic->service_uuid_high, characteristic->service_uuid_low),
+            HighLow2Uuid(characteristic->uuid_high, characteristic->uuid_low) }).first;
+    }
+    return it->second;
+}
+
 void MetaMotionController::read_gatt_char(void* context, const void* caller,
                                           const MblMwGattChar* characteristic,
                                           MblMwFnIntVoidPtrArray handler) {
     auto* self = static_cast<MetaMotionController*>(context);
-    auto data = self->peripheral.read(
-        HighLow2Uuid(characteristic->service_uuid_high, characteristic->service_uuid_low),
-        HighLow2Uuid(characteristic->uuid_high, characteristic->uuid_low));
-    handler(caller, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    const auto& uuids = self->resolve_char(characteristic);
+    auto data = self->transport->read(uuids.service, uuids.characteristic);
+    handler(caller, data.data(), static_cast<uint8_t>(data.size()));
 }
 
 void MetaMotionController::write_gatt_char(void* context, const void* caller,
@@ -311,10 +852,8 @@ void MetaMotionController::write_gatt_char(void* context, const void* caller,
                                            const MblMwGattChar* characteristic,
                                            const uint8_t* value, uint8_t length) {
     auto* self = static_cast<MetaMotionController*>(context);
-    self->peripheral.write_command(
-        HighLow2Uuid(characteristic->service_uuid_high, characteristic->service_uuid_low),
-        HighLow2Uuid(characteristic->uuid_high, characteristic->uuid_low),
-        SimpleBLE::ByteArray(value, static_cast<size_t>(length)));
+    const auto& uuids = self->resolve_char(characteristic);
+    self->transport->write(uuids.service, uuids.characteristic, value, length);
 }
 
 void MetaMotionController::enable_char_notify(void* context, const void* caller,
@@ -322,17 +861,32 @@ void MetaMotionController::enable_char_notify(void* context, const void* caller,
                                               MblMwFnIntVoidPtrArray handler,
                                               MblMwFnVoidVoidPtrInt ready) {
     auto* self = static_cast<MetaMotionController*>(context);
-    self->peripheral.notify(
-        HighLow2Uuid(characteristic->service_uuid_high, characteristic->service_uuid_low),
-        HighLow2Uuid(characteristic->uuid_high, characteristic->uuid_low),
-        [handler, caller](SimpleBLE::ByteArray payload) {
-            handler(caller, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    const auto& uuids = self->resolve_char(characteristic);
+    self->transport->notify(uuids.service, uuids.characteristic,
+        [self, handler, caller](const uint8_t* data, size_t size) {
+            std::lock_guard<std::mutex> lock(self->callbackMutex);
+            if (!self->callbacksOpen)
+                return;
+            self->lastNotifyNs.store(latency::nowNs(), std::memory_order_relaxed);
+            self->notificationCount.fetch_add(1, std::memory_order_relaxed);
+            handler(caller, data, static_cast<uint8_t>(size));
         });
     ready(caller, MBL_MW_STATUS_OK);
 }
 
-void MetaMotionController::on_disconnect(void* /*context*/, const void* caller,
+// Stops the transport calling into the SDK's disconnect handler, which
+// belongs to the board about to be freed. setup() installs a new one.
+void MetaMotionController::detach_disconnect_handler() {
+    transport->onDisconnected(nullptr);
+    disconnectHandler = nullptr;
+    disconnectCaller  = nullptr;
+}
+
+// The SDK registers a handler to run when the link drops (e.g. after a
+// board reset); the transport's disconnect callback invokes it.
+void MetaMotionController::on_disconnect(void* context, const void* caller,
                                          MblMwFnVoidVoidPtrInt handler) {
-    if (handler)
-        handler(caller, MBL_MW_STATUS_OK);
+    auto* self = static_cast<MetaMotionController*>(context);
+    self->disconnectCaller  = caller;
+    self->disconnectHandler = handler;
 }
@@ -1,10 +1,17 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 #include <stdio.h>
 
 #ifndef WIN32
@@ -12,6 +19,12 @@
 #endif
 
 #include "BleInterface.h"
+#include "BleTransport.h"
+#include "LatencyTracer.h"
+#include "SensorConfig.h"
+#include "SensorSample.h"
+#include "Seqlock.h"
+#include "SpscQueue.h"
 
 // MetaWear SDK headers
 #include "metawear/core/metawearboard.h"
@@ -27,46 +40,130 @@
 #include "metawear/core/types.h"
 #include "metawear/sensor/sensor_common.h"
 #include "metawear/sensor/sensor_fusion.h"
+#include "metawear/sensor/accelerometer.h"
+#include "metawear/sensor/gyro_bosch.h"
+#include "metawear/processor/average.h"
+#include "metawear/processor/dataprocessor.h"
+#include "metawear/processor/delta.h"
+#include "metawear/processor/time.h"
 
-// Bridges a SimpleBLE peripheral to the MetaWear C SDK.
-// Configures sensor fusion and exposes Euler, acceleration, gyro, and
-// magnetometer data as plain float arrays ready for OSC transmission.
+// Bridges a BLE transport (real SimpleBLE peripheral or simulated board) to
+// the MetaWear C SDK.
+// Configures sensor fusion as described by `sensorConfig` and publishes each
+// enabled output twice: as timestamped samples in a lock-free queue, and as
+// a seqlock-protected latest-value frame readable via snapshot().
 class MetaMotionController {
 public:
-    MetaMotionController(SimpleBLE::Peripheral& peripheralIn);
-    ~MetaMotionController();
+    using SampleQueue = SpscQueue<SensorSample, 1024>;
 
-    // Called each update tick to copy sensor fusion angles into `angle[]`.
-    void update();
+    explicit MetaMotionController(std::unique_ptr<BleTransport> transportIn);
+    ~MetaMotionController();
 
     // --- Connection ---
     bool setup();   // Initialise the MetaWear board over BLE. Returns true if started.
     void disconnectDevice(MblMwMetaWearBoard* board);
-    bool isConnected = false;
+    std::atomic<bool> isConnected{false};
+
+    // Resolves once board initialisation has finished: true when the first
+    // sample has arrived, false if the SDK reported an error or a step timed out.
+    std::shared_future<bool> ready;
+
+    // --- Initialisation state machine ---
+    // setup() enters Initializing; every later step is entered from an SDK
+    // completion callback, so nothing blocks or spins on the BLE thread.
+    enum class InitState : uint8_t {
+        Idle,               // setup() not called yet
+        Initializing,       // waiting for mbl_mw_metawearboard_initialize
+        ConfiguringFusion,  // fusion config written, waiting for the read-back
+                            // (raw IMU mode passes straight through)
+        CreatingProcessors, // building on-board processor chains, one
+                            // creation callback at a time
+        Subscribing,        // subscribing data signals and starting fusion
+        WaitingForData,     // fusion started, waiting for the first sample
+        Streaming,          // first sample received
+        Failed,             // SDK error or step timeout
+        Count
+    };
+    InitState initState() const { return state.load(); }
+
+    // Fails initialisation if the current step has exceeded its timeout.
+    // Call periodically from a non-BLE thread until `ready` resolves.
+    void poll_init_timeout();
+
+    // Moves any state short of Streaming to Failed and resolves `ready` with
+    // false, so the supervisor retries the sensor. Any thread.
+    void fail_init(const char* reason);
 
     // --- Sensor output (updated asynchronously by MetaWear callbacks) ---
-    float outputEuler[4];        // [heading/yaw, pitch, roll, yaw/heading]
-    float outputAcceleration[3]; // corrected acceleration (x, y, z)
-    float outputMag[3];          // corrected magnetometer (x, y, z)
-    float outputGyro[3];         // corrected gyroscope (x, y, z)
+    // Returns a consistent copy of the latest value of every stream. Never
+    // blocks the BLE callback thread; safe to call from any thread.
+    SensorFrame snapshot() const { return frame.load(); }
+
+    // --- Sample pipeline ---
+    // Every MetaWear data callback pushes a SensorSample here (producer: BLE
+    // callback thread, consumer: OSC streaming thread).
+    SampleQueue samples;
+    std::atomic<uint64_t> droppedSamples{0};  // samples rejected by a full queue
+
+    // Invoked on the BLE callback thread after each push; used to wake the
+    // consumer. Must be set before setup() and must not block.
+    std::function<void()> onSampleAvailable;
+
+    // Fusion mode, ranges, enabled outputs and connection parameters. Must
+    // be set before setup().
+    SensorConfig sensorConfig;
+
+    // Sensors sharing this sensor's BLE adapter (including this one); with
+    // connection auto-backoff, more sensors mean longer intervals.
+    int sensorsOnAdapter = 1;
 
-    // If true, outputEuler[0] uses the magnetometer-corrected heading;
+    // BLE adapter the sensor is assigned to (index into BleInterface::adapters).
+    size_t adapter = 0;
+
+    // --- Reconnection ---
+    // The board's address, fixed for the controller's lifetime. Unlike
+    // transport->address() it is safe to read while a reconnect swaps the
+    // transport.
+    const std::string address;
+
+    // Set when the transport reports a dropped link.
+    std::atomic<bool> linkDropped{false};
+
+    // True if the sensor needs reconnecting: initialisation failed, or the
+    // link dropped while streaming (or, with silenceMs > 0, went that long
+    // without a notification). Supervisor thread only.
+    bool link_lost(int silenceMs);
+
+    // Supervisor thread: stops notifications and frees the board so the
+    // peripheral advertises again.
+    void release_link();
+
+    // Supervisor thread, after release_link(): installs `newTransport` (null
+    // keeps the current one) and rewinds the state machine so setup() can
+    // run again. The sample queue, sequence numbers and therefore the OSC
+    // index are kept. setup() restores the board state saved on the first
+    // successful initialisation, which skips module discovery.
+    void prepare_reconnect(std::unique_ptr<BleTransport> newTransport);
+
+    // --- Link throughput ---
+    // Notification rate since the previous call against the rate the
+    // configured outputs should produce. Call from one non-BLE thread.
+    struct LinkRate {
+        double notificationsHz = 0.0;
+        double expectedHz      = 0.0;
+    };
+    LinkRate measure_link_rate();
+
+    // If true, euler[0] uses the magnetometer-corrected heading;
     // otherwise it uses the gyro-integrated yaw.
     bool bUseMagnoHeading = true;
 
-    // --- Orientation helpers ---
-    float angle[3];              // Current Euler angles (yaw/heading, pitch, roll)
-    float angle_shift[3];        // Offset applied by recenter()
-    std::array<float, 3> getAngle();  // Returns angle[] + angle_shift[]
-    void resetOrientation();     // Zeroes angle_shift
-    void recenter();             // Sets angle_shift so current angle reads as zero
-
     // --- Device info ---
     int battery_level = 0;
     const char* module_name = nullptr;
 
-    // --- BLE peripheral and MetaWear board handle ---
-    SimpleBLE::Peripheral& peripheral;
+    // --- BLE transport and MetaWear board handle ---
+    std::unique_ptr<BleTransport> transport;
     MblMwMetaWearBoard* board = nullptr;
 
     // --- Board configuration helpers ---
@@ -74,12 +171,28 @@ public:
     void get_battery_percentage(MblMwMetaWearBoard* board);
     void configure_sensor_fusion(MblMwMetaWearBoard* board);
     void enable_fusion_sampling(MblMwMetaWearBoard* board);
+    void create_onboard_processors(MblMwMetaWearBoard* board);
+    void remove_onboard_processors();
     void disable_fusion_sampling(MblMwMetaWearBoard* board);
+    void apply_connection_parameters(MblMwMetaWearBoard* board);
+    void configure_raw_imu(MblMwMetaWearBoard* board);
+    void enable_raw_imu_sampling(MblMwMetaWearBoard* board);
+    void disable_raw_imu_sampling(MblMwMetaWearBoard* board);
+
+    // Packed signals deliver several readings per notification, all carrying
+    // the notification's epoch. Returns the epoch of the current reading,
+    // spread back out at the raw output data rate. BLE thread only.
+    int64_t unpack_epoch(SensorStream stream, int64_t epoch);
     void enable_led(MblMwMetaWearBoard* board);
     void disable_led(MblMwMetaWearBoard* board);
     void set_ad_name(MblMwMetaWearBoard* board);
     void get_ad_name(MblMwMetaWearBoard* board);
 
+    // Publish a sample: update the snapshot frame, queue the sample for the
+    // consumer and wake it. Called only from MetaWear data callbacks.
+    void publish_sample(SensorStream stream, int64_t epoch,
+                        const float* values, uint8_t numValues);
+
     // --- MetaWear GATT bridge callbacks (called by the MetaWear C SDK) ---
     static void read_gatt_char(void* context, const void* caller,
                                const MblMwGattChar* characteristic,
@@ -97,4 +210,109 @@ public:
 
     static void on_disconnect(void* context, const void* caller,
                               MblMwFnVoidVoidPtrInt handler);
+
+private:
+    // --- GATT characteristic cache ---
+    // SimpleBLE wants UUID strings; the SDK hands us 128-bit halves. Each
+    // characteristic is formatted once and looked up by its 128-bit UUID.
+    struct GattCharUuids {
+        std::string service;
+        std::string characteristic;
+    };
+    struct GattCharKey {
+        uint64_t high, low;
+        bool operator==(const GattCharKey& o) const { return high == o.high && low == o.low; }
+    };
+    struct GattCharKeyHash {
+        size_t operator()(const GattCharKey& k) const {
+            return std::hash<uint64_t>()(k.high ^ (k.low * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+    const GattCharUuids& resolve_char(const MblMwGattChar* characteristic);
+
+    // Entries are never erased, so references stay valid after unlocking.
+    std::unordered_map<GattCharKey, GattCharUuids, GattCharKeyHash> gattCharCache;
+    std::mutex gattCharCacheMutex;
+
+    void signal_ready(bool success);
+    void detach_disconnect_handler();
+    void start_streaming(MblMwMetaWearBoard* board);
+
+    // Creates the next processor of the chains in sensorConfig.onboard, or
+    // moves on to Subscribing when every chain is built. A failed chain is
+    // removed and its output falls back to the plain fusion signal.
+    void create_next_processor(MblMwMetaWearBoard* board);
+    static void on_processor_created(void* context, MblMwDataProcessor* processor);
+    void abandon_chain(const char* reason);
+    void save_board_state();
+
+    // mbl_mw_metawearboard_serialize() output from the last successful
+    // initialisation; restored by setup() on reconnect.
+    std::vector<uint8_t> boardState;
+
+    // Registered by the SDK through on_disconnect(); run when the link drops.
+    MblMwFnVoidVoidPtrInt disconnectHandler = nullptr;
+    const void*           disconnectCaller  = nullptr;
+
+    // Moves from `from` to `to` and records how long `from` took. Returns
+    // false if the state changed meanwhile (e.g. the step timed out), in
+    // which case the caller must drop the late callback.
+    bool advance_init(InitState from, InitState to);
+    static int step_timeout_ms(InitState step);
+    static int64_t now_ns();
+
+    // Arrival time of the notification currently being handled; the SDK
+    // invokes data callbacks synchronously from the notify handler.
+    std::atomic<int64_t> lastNotifyNs{0};
+
+    // Held by every transport callback for its whole run. close_callbacks()
+    // clears `callbacksOpen` under it, so once it returns no callback is
+    // running and none will touch `board` again; setup() reopens them.
+    std::mutex callbackMutex;
+    bool       callbacksOpen = false;
+    void close_callbacks();
+
+    // Every BLE notification received, for measure_link_rate().
+    std::atomic<uint64_t> notificationCount{0};
+    uint64_t lastLinkCount  = 0;
+    int64_t  lastLinkNs     = 0;
+    double expected_notification_rate() const;
+
+    std::atomic<InitState> state{InitState::Idle};
+    std::atomic<int64_t>   stepStartNs{0};
+    int64_t stepDurationMs[static_cast<int>(InitState::Count)] = {};
+
+    std::promise<bool> readyPromise;
+    std::atomic<bool>  readySignalled{false};
+
+    // All data callbacks of one board arrive on the same BLE thread, which is
+    // the seqlock's single writer. `latestFrame` is that thread's working copy.
+    Seqlock<SensorFrame> frame;
+    SensorFrame latestFrame;
+
+    // Raw IMU mode: position of the current reading within its packed
+    // notification, per stream (acc, gyro).
+    struct PackedPosition {
+        int64_t notifyNs = -1;
+        int     index    = 0;
+    };
+    PackedPosition packedPosition[2];
+    bool gyroIsBmi270 = false;
+
+    // On-board processor chains, per stream: the first processor (removing
+    // it removes the whole chain) and the signal to subscribe to instead of
+    // the fusion output. Both null when the stream has no chain.
+    MblMwDataProcessor* onboardHead[kNumSensorStreams]   = {};
+    MblMwDataSignal*    onboardSignal[kNumSensorStreams] = {};
+
+    // Ids of the chain heads left on the board when the link was lost;
+    // removed by create_onboard_processors() after reconnecting.
+    std::vector<uint8_t> staleProcessors;
+
+    // Chain currently being built by create_next_processor().
+    struct OnboardCursor {
+        int stream = 0;
+        int stage  = 0;   // next stage: 0 average, 1 delta, 2 time
+    };
+    OnboardCursor onboardCursor;
 };
@@ -0,0 +1,233 @@
+//
+//  OrientationStage.cpp
+//
+//  Struct-of-arrays quaternion recenter / mounting / world-frame correction
+//  over every sensor of the rig.
+//
+
+#include "OrientationStage.h"
+#include "BleInterface.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+// Reads a [w, x, y, z] quaternion from `json`, normalised; identity if it is
+// missing or degenerate.
+void readQuaternion(const nlohmann::json& json, float q[4]) {
+    q[0] = 1.0f; q[1] = q[2] = q[3] = 0.0f;
+    if (!json.is_array() || json.size() != 4) {
+        juce::Logger::writeToLog("Orientation quaternions must be [w, x, y, z], ignoring.");
+        return;
+    }
+    float v[4];
+    for (size_t k = 0; k < 4; ++k)
+        v[k] = json[k].get<float>();
+    const float norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3]);
+    if (norm < 1e-6f)
+        return;
+    for (int k = 0; k < 4; ++k)
+        q[k] = v[k] / norm;
+}
+
+// Struct-of-arrays kernels. GCC only trusts __restrict on parameters, so
+// they are free functions rather than loops inside process().
+
+// t = a * b for n quaternions.
+void multiply(size_t n,
+              const float* __restrict aw, const float* __restrict ax, const float* __restrict ay, const float* __restrict az,
+              const float* __restrict bw, const float* __restrict bx, const float* __restrict by, const float* __restrict bz,
+              float* __restrict tw, float* __restrict tx, float* __restrict ty, float* __restrict tz) {
+    for (size_t i = 0; i < n; ++i) {
+        tw[i] = aw[i] * bw[i] - ax[i] * bx[i] - ay[i] * by[i] - az[i] * bz[i];
+        tx[i] = aw[i] * bx[i] + ax[i] * bw[i] + ay[i] * bz[i] - az[i] * by[i];
+        ty[i] = aw[i] * by[i] - ax[i] * bz[i] + ay[i] * bw[i] + az[i] * bx[i];
+        tz[i] = aw[i] * bz[i] + ax[i] * by[i] - ay[i] * bx[i] + az[i] * bw[i];
+    }
+}
+
+// v = a * v, renormalised, for n quaternions and one fixed `a`. The inputs
+// are unit length to within float precision, so one Newton step stands in
+// for 1/sqrt and keeps the loop free of libm calls.
+void rotateNormalise(size_t n, const float a[4],
+                     float* __restrict vw, float* __restrict vx, float* __restrict vy, float* __restrict vz) {
+    const float aw = a[0], ax = a[1], ay = a[2], az = a[3];
+    for (size_t i = 0; i < n; ++i) {
+        const float w = aw * vw[i] - ax * vx[i] - ay * vy[i] - az * vz[i];
+        const float x = aw * vx[i] + ax * vw[i] + ay * vz[i] - az * vy[i];
+        const float y = aw * vy[i] - ax * vz[i] + ay * vw[i] + az * vx[i];
+        const float z = aw * vz[i] + ax * vy[i] - ay * vx[i] + az * vw[i];
+        const float inv = 1.5f - 0.5f * (w * w + x * x + y * y + z * z);
+        vw[i] = w * inv; vx[i] = x * inv; vy[i] = y * inv; vz[i] = z * inv;
+    }
+}
+
+// Row-major rotation matrix of each of n quaternions, 9 floats apiece.
+void toMatrices(size_t n,
+                const float* __restrict qw, const float* __restrict qx, const float* __restrict qy, const float* __restrict qz,
+                float* __restrict m) {
+    for (size_t i = 0; i < n; ++i) {
+        const float w = qw[i], x = qx[i], y = qy[i], z = qz[i];
+        float* r = m + i * 9;
+        r[0] = 1.0f - 2.0f * (y * y + z * z);
+        r[1] = 2.0f * (x * y - w * z);
+        r[2] = 2.0f * (x * z + w * y);
+        r[3] = 2.0f * (x * y + w * z);
+        r[4] = 1.0f - 2.0f * (x * x + z * z);
+        r[5] = 2.0f * (y * z - w * x);
+        r[6] = 2.0f * (x * z - w * y);
+        r[7] = 2.0f * (y * z + w * x);
+        r[8] = 1.0f - 2.0f * (x * x + y * y);
+    }
+}
+
+} // namespace
+
+OrientationStage::~OrientationStage() {
+    if (listening) {
+        receiver.removeListener(this);
+        receiver.disconnect();
+    }
+}
+
+void OrientationStage::configure(const nlohmann::json& orientation, const std::vector<std::string>& addresses) {
+    numSensors = static_cast<int>(addresses.size());
+    if (numSensors == 0)
+        return;
+
+    yawOnly = orientation.value("recenter", std::string("yaw")) != "full";
+    matrix  = orientation.value("matrix", false);
+    if (orientation.contains("world"))
+        readQuaternion(orientation["world"], world);
+
+    float defaultMounting[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    if (orientation.contains("mounting"))
+        readQuaternion(orientation["mounting"], defaultMounting);
+
+    const size_t sensors = addresses.size();
+    for (auto* v : { &qw, &qx, &qy, &qz, &mw, &mx, &my, &mz, &rw, &rx, &ry, &rz,
+                     &ow, &ox, &oy, &oz, &cw, &cx, &cy, &cz })
+        v->assign(sensors, 0.0f);
+    std::fill(qw.begin(), qw.end(), 1.0f);
+    std::fill(rw.begin(), rw.end(), 1.0f);
+    rotation.assign(sensors * 9, 0.0f);
+    epoch.assign(sensors, 0);
+    fresh.assign(sensors, 0);
+    seen.assign(sensors, 0);
+    pending.reset(new std::atomic<uint8_t>[sensors]);
+
+    quatMessages.resize(sensors);
+    matrixMessages.resize(sensors);
+    char address[48];
+    for (size_t i = 0; i < sensors; ++i) {
+        pending[i].store(None, std::memory_order_relaxed);
+
+        float mounting[4] = { defaultMounting[0], defaultMounting[1], defaultMounting[2], defaultMounting[3] };
+        if (orientation.contains("sensors") && !addresses[i].empty()) {
+            const auto wanted = BleInterface::normaliseAddress(addresses[i]);
+            for (const auto& entry : orientation["sensors"].items())
+                if (BleInterface::normaliseAddress(entry.key()) == wanted && entry.value().contains("mounting"))
+                    readQuaternion(entry.value()["mounting"], mounting);
+        }
+        // Stored conjugated: it is only ever applied as conj(mounting).
+        mw[i] = mounting[0];
+        mx[i] = -mounting[1];
+        my[i] = -mounting[2];
+        mz[i] = -mounting[3];
+
+        std::snprintf(address, sizeof address, "/orient/%d", static_cast<int>(i));
+        quatMessages[i].build(address, 4);
+        std::snprintf(address, sizeof address, "/rotmat/%d", static_cast<int>(i));
+        matrixMessages[i].build(address, 9);
+    }
+
+    const int port = orientation.value("osc_port", 0);
+    if (port > 0) {
+        listening = receiver.connect(port);
+        if (listening) {
+            receiver.addListener(this, "/metaosc/recenter");
+            receiver.addListener(this, "/metaosc/recenter/clear");
+            juce::Logger::writeToLog(juce::String::formatted("Listening for /metaosc/recenter on port %d", port));
+        } else {
+            juce::Logger::writeToLog(juce::String::formatted("Could not open recenter port %d", port));
+        }
+    }
+}
+
+void OrientationStage::requestRecenter(int sensor, bool clear) {
+    if (sensor >= numSensors)
+        return;
+    const uint8_t request = clear ? Clear : Recenter;
+    if (sensor < 0) {
+        for (int i = 0; i < numSensors; ++i)
+            pending[static_cast<size_t>(i)].store(request, std::memory_order_relaxed);
+    } else {
+        pending[static_cast<size_t>(sensor)].store(request, std::memory_order_relaxed);
+    }
+    recenterPending.store(true, std::memory_order_release);
+}
+
+// OSC receiver thread.
+void OrientationStage::oscMessageReceived(const juce::OSCMessage& message) {
+    const bool clear = message.getAddressPattern().toString().endsWith("/clear");
+    int sensor = -1;
+    if (!message.isEmpty()) {
+        if (message[0].isInt32())
+            sensor = message[0].getInt32();
+        else if (message[0].isFloat32())
+            sensor = static_cast<int>(message[0].getFloat32());
+    }
+    requestRecenter(sensor, clear);
+}
+
+// ---------------------------------------------------------------------------
+// Per pass
+// ---------------------------------------------------------------------------
+
+void OrientationStage::process() {
+    const size_t n = static_cast<size_t>(numSensors);
+    for (size_t i = 0; i < n; ++i)
+        seen[i] |= fresh[i];
+
+    // c = world * q * conj(mounting)
+    multiply(n, qw.data(), qx.data(), qy.data(), qz.data(),
+                mw.data(), mx.data(), my.data(), mz.data(),
+                cw.data(), cx.data(), cy.data(), cz.data());
+    rotateNormalise(n, world, cw.data(), cx.data(), cy.data(), cz.data());
+
+    // Recenter requests: the new reference is the inverse of the current
+    // orientation, or of its twist about the vertical axis for "yaw".
+    if (recenterPending.exchange(false, std::memory_order_acquire)) {
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t request = pending[i].exchange(None, std::memory_order_relaxed);
+            if (request == None || (request == Recenter && !seen[i]))
+                continue;
+            float r[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+            if (request == Recenter) {
+                r[0] = cw[i];
+                r[3] = -cz[i];
+                if (yawOnly) {
+                    // Degenerate only when the body is upside down with no
+                    // defined heading; keep the identity then.
+                    const float norm = std::sqrt(r[0] * r[0] + r[3] * r[3]);
+                    if (norm > 1e-6f) { r[0] /= norm; r[3] /= norm; }
+                    else              { r[0] = 1.0f;  r[3] = 0.0f; }
+                } else {
+                    r[1] = -cx[i];
+                    r[2] = -cy[i];
+                }
+            }
+            rw[i] = r[0]; rx[i] = r[1]; ry[i] = r[2]; rz[i] = r[3];
+        }
+    }
+
+    // out = recenter * c
+    multiply(n, rw.data(), rx.data(), ry.data(), rz.data(),
+                cw.data(), cx.data(), cy.data(), cz.data(),
+                ow.data(), ox.data(), oy.data(), oz.data());
+
+    if (matrix)
+        toMatrices(n, ow.data(), ox.data(), oy.data(), oz.data(), rotation.data());
+}
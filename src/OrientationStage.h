@@ -0,0 +1,140 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "OscPacketEncoder.h"
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Quaternion orientation stage: recenter, mounting offset and world frame.
+//
+// Works on the fusion quaternion, which has no gimbal lock at pitch ±90° and
+// no seam at the heading wrap. Each sensor's body orientation is
+//     out = recenter[i] * world * q[i] * conj(mounting[i])
+// where `mounting` is how the board sits on the body it is strapped to and
+// `world` rotates the board's earth frame into the venue's. Quaternions
+// drained in one pass of the streaming loop are corrected in a single
+// struct-of-arrays pass over every sensor and sent as one bundle of
+// /orient/{index} w x y z, plus /rotmat/{index} (row-major 3x3) if asked.
+//
+// Recentering makes the current orientation the new zero, about the
+// vertical axis only ("yaw", the default) or fully ("full"). It can be
+// triggered at runtime with /metaosc/recenter [index] on `osc_port` (no
+// index = every sensor); /metaosc/recenter/clear undoes it.
+//
+// config["orientation"]:
+//     "recenter": "yaw",                 yaw | full
+//     "world": [1, 0, 0, 0],             w x y z
+//     "mounting": [1, 0, 0, 0],          default for every sensor
+//     "sensors": { "AA:BB:CC:DD:EE:FF": { "mounting": [0.7071, 0, 0, 0.7071] } },
+//     "matrix": false,                   also send /rotmat/{index}
+//     "osc_port": 9000                   recenter commands (0 = off)
+// ---------------------------------------------------------------------------
+
+class OrientationStage : private juce::OSCReceiver::ListenerWithOSCAddress<juce::OSCReceiver::RealtimeCallback> {
+public:
+    ~OrientationStage() override;
+
+    // Sizes every buffer and opens the command port. `addresses` holds each
+    // sensor's MAC by OSC index (empty in replay: default mounting).
+    void configure(const nlohmann::json& orientation, const std::vector<std::string>& addresses);
+
+    bool enabled() const { return numSensors > 0; }
+
+    // Any thread: recenter (or clear the recentering of) one sensor, or
+    // every sensor if `sensor` is negative. Applied on the next pass.
+    void requestRecenter(int sensor, bool clear = false);
+
+    // Streaming thread: keeps the newest quaternion of each sensor.
+    void push(int sensor, const SensorSample& sample) {
+        if (sample.stream != SensorStream::Quat)
+            return;
+        const size_t i = static_cast<size_t>(sensor);
+        qw[i] = sample.values[0];
+        qx[i] = sample.values[1];
+        qy[i] = sample.values[2];
+        qz[i] = sample.values[3];
+        epoch[i] = sample.epoch;
+        fresh[i] = 1;
+        anyFresh = true;
+    }
+
+    // Streaming thread: corrects every sensor in one pass and emits the
+    // sensors with new data into `sink` (osc::StageSink).
+    template <typename Sink>
+    void flush(Sink& sink) {
+        if (!anyFresh && !recenterPending.load(std::memory_order_relaxed))
+            return;
+        process();
+        if (!anyFresh)
+            return;
+
+        int64_t firstEpoch = 0;
+        for (int i = 0; i < numSensors; ++i)
+            if (fresh[static_cast<size_t>(i)] && (firstEpoch == 0 || epoch[static_cast<size_t>(i)] < firstEpoch))
+                firstEpoch = epoch[static_cast<size_t>(i)];
+
+        constexpr uint32_t kQuat = 1u << static_cast<int>(SensorStream::Quat);
+        sink.begin(osc::timeTagFromEpochMs(firstEpoch));
+        for (int i = 0; i < numSensors; ++i) {
+            const size_t s = static_cast<size_t>(i);
+            if (!fresh[s])
+                continue;
+            fresh[s] = 0;
+
+            const float q[4] = { ow[s], ox[s], oy[s], oz[s] };
+            quatMessages[s].setValues(q);
+            sink.add(i, kQuat, quatMessages[s]);
+            if (matrix) {
+                matrixMessages[s].setValues(&rotation[s * 9]);
+                sink.add(i, kQuat, matrixMessages[s]);
+            }
+        }
+        anyFresh = false;
+        sink.end();
+    }
+
+private:
+    using MatrixMessage = osc::BasicOscMessageTemplate<80, 9>;
+
+    enum Pending : uint8_t { None = 0, Recenter, Clear };
+
+    void oscMessageReceived(const juce::OSCMessage& message) override;
+    void process();
+
+    int  numSensors = 0;
+    bool yawOnly    = true;
+    bool matrix     = false;
+    float world[4]  = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+    // Per sensor, struct-of-arrays: newest input, conj(mounting), recenter
+    // rotation and output.
+    std::vector<float>   qw, qx, qy, qz;
+    std::vector<float>   mw, mx, my, mz;
+    std::vector<float>   rw, rx, ry, rz;
+    std::vector<float>   ow, ox, oy, oz;
+    std::vector<float>   cw, cx, cy, cz;   // world * q * conj(mounting), before recentering
+    std::vector<float>   rotation;         // per sensor * 9
+    std::vector<int64_t> epoch;
+    std::vector<uint8_t> fresh;
+    std::vector<uint8_t> seen;             // has delivered at least one quaternion
+    bool                 anyFresh = false;
+
+    // Set by requestRecenter() on any thread, consumed by process().
+    std::unique_ptr<std::atomic<uint8_t>[]> pending;
+    std::atomic<bool>                       recenterPending{false};
+
+    std::vector<osc::OscMessageTemplate> quatMessages;
+    std::vector<MatrixMessage>           matrixMessages;
+
+    juce::OSCReceiver receiver;
+    bool              listening = false;
+};
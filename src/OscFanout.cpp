@@ -0,0 +1,235 @@
+//
+//  OscFanout.cpp
+//
+//  Per-destination packet queues and UDP sender workers.
+//
+
+#include "OscFanout.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace osc {
+
+OverflowPolicy OscFanout::parsePolicy(const std::string& name) {
+    if (name == "drop_newest")
+        return OverflowPolicy::DropNewest;
+    if (name != "drop_oldest")
+        juce::Logger::writeToLog("Unknown overflow policy '" + juce::String(name) + "', using drop_oldest.");
+    return OverflowPolicy::DropOldest;
+}
+
+int OscFanout::addDestination(const std::string& host, int port,
+                              size_t queueCapacity, OverflowPolicy policy) {
+    auto d = std::make_unique<Destination>();
+    d->host   = host;
+    d->port   = port;
+    d->policy = policy;
+    d->ring.resize(std::max<size_t>(queueCapacity, 2));
+    destinations.push_back(std::move(d));
+    return size() - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Lifecycle
+// ---------------------------------------------------------------------------
+
+void OscFanout::start() {
+    if (running)
+        return;
+    running = true;
+    for (auto& d : destinations) {
+        if (!openSocket(*d))
+            juce::Logger::writeToLog(juce::String::formatted("OSC destination %s:%d: could not open socket",
+                                                             d->host.c_str(), d->port));
+        d->stopping = false;
+        Destination* dest = d.get();
+        d->worker = std::thread([this, dest] { senderLoop(*dest); });
+    }
+}
+
+void OscFanout::stop() {
+    if (!running)
+        return;
+    running = false;
+    for (auto& d : destinations) {
+        {
+            std::lock_guard<std::mutex> lock(d->mutex);
+            d->stopping = true;
+        }
+        d->wake.notify_one();
+    }
+    for (auto& d : destinations) {
+        if (d->worker.joinable())
+            d->worker.join();
+        closeSocket(*d);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Producer side
+// ---------------------------------------------------------------------------
+
+void OscFanout::publish(const uint8_t* data, size_t size) {
+    for (int i = 0; i < this->size(); ++i)
+        publishTo(i, data, size);
+}
+
+void OscFanout::publishTo(int index, const uint8_t* data, size_t size) {
+    if (size == 0 || size > kMaxPacketSize)
+        return;
+
+    Destination& d = *destinations[static_cast<size_t>(index)];
+    const size_t capacity = d.ring.size();
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (d.head - d.tail == capacity) {
+            d.dropped.fetch_add(1, std::memory_order_relaxed);
+            if (d.policy == OverflowPolicy::DropNewest)
+                return;
+            ++d.tail;   // DropOldest: overwrite the packet that would be sent next
+        }
+        wasEmpty = d.head == d.tail;
+        Packet& slot = d.ring[d.head % capacity];
+        std::memcpy(slot.data.data(), data, size);
+        slot.size = static_cast<uint32_t>(size);
+        ++d.head;
+    }
+    // The worker only sleeps on an empty queue.
+    if (wasEmpty)
+        d.wake.notify_one();
+}
+
+OscFanout::Stats OscFanout::takeStats(int index) {
+    Destination& d = *destinations[static_cast<size_t>(index)];
+    Stats s;
+    s.sent    = d.sent.exchange(0, std::memory_order_relaxed);
+    s.dropped = d.dropped.exchange(0, std::memory_order_relaxed);
+    s.errors  = d.errors.exchange(0, std::memory_order_relaxed);
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Sender workers
+// ---------------------------------------------------------------------------
+
+void OscFanout::senderLoop(Destination& d) {
+    const size_t capacity = d.ring.size();
+    std::vector<Packet> batch(kSendBatch);
+
+    for (;;) {
+        size_t count = 0;
+        {
+            std::unique_lock<std::mutex> lock(d.mutex);
+            d.wake.wait(lock, [&d] { return d.stopping || d.head != d.tail; });
+            if (d.stopping && d.head == d.tail)
+                return;
+            // Copy out so the producer never waits on a send.
+            while (count < kSendBatch && d.tail != d.head) {
+                const Packet& slot = d.ring[d.tail % capacity];
+                batch[count].size = slot.size;
+                std::memcpy(batch[count].data.data(), slot.data.data(), slot.size);
+                ++count;
+                ++d.tail;
+            }
+        }
+        sendBatch(d, batch.data(), count);
+    }
+}
+
+#if defined(__linux__)
+
+bool OscFanout::openSocket(Destination& d) {
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    const std::string port = std::to_string(d.port);
+    if (getaddrinfo(d.host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    // Connect once so the address is resolved here and not per send.
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        const int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            d.fd = fd;
+            break;
+        }
+        ::close(fd);
+    }
+    freeaddrinfo(result);
+    return d.fd >= 0;
+}
+
+void OscFanout::closeSocket(Destination& d) {
+    if (d.fd >= 0)
+        ::close(d.fd);
+    d.fd = -1;
+}
+
+void OscFanout::sendBatch(Destination& d, Packet* packets, size_t count) {
+    if (d.fd < 0) {
+        d.errors.fetch_add(count, std::memory_order_relaxed);
+        return;
+    }
+
+    mmsghdr messages[kSendBatch];
+    iovec   vectors[kSendBatch];
+    std::memset(messages, 0, sizeof messages);
+    for (size_t i = 0; i < count; ++i) {
+        vectors[i].iov_base = packets[i].data.data();
+        vectors[i].iov_len  = packets[i].size;
+        messages[i].msg_hdr.msg_iov    = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t done = 0;
+    while (done < count) {
+        const int n = ::sendmmsg(d.fd, messages + done, static_cast<unsigned>(count - done), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            // e.g. ECONNREFUSED from a previous datagram: skip the packet
+            // that failed and keep going.
+            d.errors.fetch_add(1, std::memory_order_relaxed);
+            ++done;
+            continue;
+        }
+        done += static_cast<size_t>(n);
+        d.sent.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+    }
+}
+
+#else
+
+bool OscFanout::openSocket(Destination& /*d*/) {
+    return true;   // juce::DatagramSocket binds lazily on first write
+}
+
+void OscFanout::closeSocket(Destination& d) {
+    d.socket.shutdown();
+}
+
+void OscFanout::sendBatch(Destination& d, Packet* packets, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (d.socket.write(d.host, d.port, packets[i].data.data(), static_cast<int>(packets[i].size)) < 0)
+            d.errors.fetch_add(1, std::memory_order_relaxed);
+        else
+            d.sent.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#endif
+
+} // namespace osc
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OscPacketEncoder.h"
+
+// ---------------------------------------------------------------------------
+// Non-blocking fan-out of encoded OSC packets to UDP destinations.
+//
+// The streaming thread encodes each packet once and publish()es it; the
+// packet is copied into a bounded queue per destination and the call
+// returns without touching a socket. One sender worker per destination
+// drains its queue in batches (sendmmsg on Linux), so a destination with a
+// broken route or a full socket buffer only ever backs up its own queue.
+// When a queue is full the destination's overflow policy decides whether
+// the oldest queued packet or the new one is dropped.
+// ---------------------------------------------------------------------------
+
+namespace osc {
+
+enum class OverflowPolicy {
+    DropOldest,   // "drop_oldest": keep the freshest data (default)
+    DropNewest    // "drop_newest": keep what is already queued
+};
+
+class OscFanout {
+public:
+    struct Packet {
+        uint32_t size = 0;
+        std::array<uint8_t, kMaxPacketSize> data;
+    };
+
+    struct Stats {
+        uint64_t sent    = 0;   // packets handed to the socket
+        uint64_t dropped = 0;   // packets lost to queue overflow
+        uint64_t errors  = 0;   // packets the socket refused
+    };
+
+    OscFanout() = default;
+    ~OscFanout() { stop(); }
+
+    // Adds a destination before start(). Returns its index.
+    int addDestination(const std::string& host, int port,
+                       size_t queueCapacity = 256,
+                       OverflowPolicy policy = OverflowPolicy::DropOldest);
+
+    void start();
+    void stop();
+
+    int size() const { return static_cast<int>(destinations.size()); }
+    const std::string& host(int index) const { return destinations[static_cast<size_t>(index)]->host; }
+    int port(int index) const { return destinations[static_cast<size_t>(index)]->port; }
+
+    // Streaming thread: queue a packet for every destination, or for one.
+    // Never blocks on the network and never allocates.
+    void publish(const uint8_t* data, size_t size);
+    void publishTo(int index, const uint8_t* data, size_t size);
+
+    // Counters since the previous call (per destination).
+    Stats takeStats(int index);
+
+    static OverflowPolicy parsePolicy(const std::string& name);
+
+private:
+    static constexpr size_t kSendBatch = 32;
+
+    struct Destination {
+        std::string    host;
+        int            port = 0;
+        OverflowPolicy policy = OverflowPolicy::DropOldest;
+
+        // Bounded ring of preallocated packets, guarded by `mutex`. The lock
+        // is only held for a memcpy, never across a send.
+        std::vector<Packet>     ring;
+        size_t                  head = 0;   // next slot to write
+        size_t                  tail = 0;   // next slot to send
+        std::mutex              mutex;
+        std::condition_variable wake;
+        bool                    stopping = false;
+
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> errors{0};
+
+#if defined(__linux__)
+        int fd = -1;                        // connected UDP socket
+#else
+        juce::DatagramSocket socket;
+#endif
+        std::thread worker;
+    };
+
+    void senderLoop(Destination& d);
+    static bool openSocket(Destination& d);
+    static void closeSocket(Destination& d);
+    static void sendBatch(Destination& d, Packet* packets, size_t count);
+
+    std::vector<std::unique_ptr<Destination>> destinations;
+    bool running = false;
+};
+
+} // namespace osc
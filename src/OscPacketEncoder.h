@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Allocation-free OSC 1.0 encoder for the streaming hot path.
+//
+// OscMessageTemplate holds a fully serialised message for one
+// (sensor, stream) pair. The address and type-tag string are written once
+// when the template is built; per sample only the big-endian float payload
+// is patched in place. OscPacketBuilder assembles templates into (possibly
+// nested) bundles inside a fixed buffer. Nothing here touches the heap after
+// OscPacketEncoder::prepare().
+// ---------------------------------------------------------------------------
+
+namespace osc {
+
+// Largest datagram we ever build. Drain sizes in the streaming loop are
+// chosen so a full per-sensor bundle always fits.
+constexpr size_t kMaxPacketSize = 8192;
+
+// Seconds between the NTP epoch (1900) and the Unix epoch (1970).
+constexpr uint64_t kNtpUnixOffsetSeconds = 2208988800ULL;
+
+// Converts a MetaWear epoch (ms since the Unix epoch) to an NTP timetag.
+inline uint64_t timeTagFromEpochMs(int64_t epochMs) {
+    const uint64_t ms       = static_cast<uint64_t>(epochMs);
+    const uint64_t seconds  = ms / 1000 + kNtpUnixOffsetSeconds;
+    const uint64_t fraction = ((ms % 1000) << 32) / 1000;
+    return (seconds << 32) | fraction;
+}
+
+inline void writeBigEndian32(uint8_t* dst, uint32_t v) {
+    dst[0] = static_cast<uint8_t>(v >> 24);
+    dst[1] = static_cast<uint8_t>(v >> 16);
+    dst[2] = static_cast<uint8_t>(v >> 8);
+    dst[3] = static_cast<uint8_t>(v);
+}
+
+inline void writeBigEndian64(uint8_t* dst, uint64_t v) {
+    writeBigEndian32(dst,     static_cast<uint32_t>(v >> 32));
+    writeBigEndian32(dst + 4, static_cast<uint32_t>(v));
+}
+
+inline void writeBigEndianFloat(uint8_t* dst, float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    writeBigEndian32(dst, bits);
+}
+
+// OSC strings are NUL terminated and padded to a multiple of four bytes.
+inline size_t paddedStringSize(size_t length) {
+    return (length + 4) & ~static_cast<size_t>(3);
+}
+
+// A serialised OSC message with a fixed address and up to `MaxValues`
+// float32 arguments, in at most `MaxSize` bytes.
+template <size_t MaxSize, int MaxValues>
+class BasicOscMessageTemplate {
+public:
+    static constexpr size_t kMaxSize   = MaxSize;
+    static constexpr int    kMaxValues = MaxValues;
+
+    // Writes address and type tags. Returns false if they do not fit.
+    bool build(const char* address, int valueCount) {
+        if (valueCount < 0 || valueCount > kMaxValues)
+            return false;
+
+        const size_t addressLength = std::strlen(address);
+        const size_t addressSize   = paddedStringSize(addressLength);
+        const size_t tagsSize      = paddedStringSize(1 + static_cast<size_t>(valueCount));
+        const size_t total         = addressSize + tagsSize + 4 * static_cast<size_t>(valueCount);
+        if (total > kMaxSize)
+            return false;
+
+        bytes_.fill(0);
+        std::memcpy(bytes_.data(), address, addressLength);
+
+        uint8_t* tags = bytes_.data() + addressSize;
+        tags[0] = ',';
+        for (int i = 0; i < valueCount; ++i)
+            tags[1 + i] = 'f';
+
+        payloadOffset_ = addressSize + tagsSize;
+        numValues_     = static_cast<uint8_t>(valueCount);
+        size_          = total;
+        return true;
+    }
+
+    // Patches the float payload in place.
+    void setValues(const float* values) {
+        uint8_t* payload = bytes_.data() + payloadOffset_;
+        for (int i = 0; i < numValues_; ++i)
+            writeBigEndianFloat(payload + 4 * i, values[i]);
+    }
+
+    const uint8_t* data() const { return bytes_.data(); }
+    size_t size() const { return size_; }
+
+private:
+    std::array<uint8_t, kMaxSize> bytes_{};
+    size_t  size_          = 0;
+    size_t  payloadOffset_ = 0;
+    uint8_t numValues_     = 0;
+};
+
+// Template used for sensor streams (at most four values).
+using OscMessageTemplate = BasicOscMessageTemplate<64, 4>;
+
+// Builds one datagram (a single message or a bundle tree) in a fixed buffer.
+// Anything that would not fit is refused rather than written: the builder
+// is marked overflowed() and takes nothing more until reset(), so the bytes
+// already built stay a well-formed packet. Callers that must not lose data
+// check remaining() first and start a new packet.
+class OscPacketBuilder {
+public:
+    static constexpr int    kMaxDepth          = 4;
+    static constexpr size_t kBundleHeaderSize  = 16;  // "#bundle\0" + timetag
+    static constexpr size_t kElementPrefixSize = 4;   // int32 element size
+    static constexpr size_t kNoRoom            = SIZE_MAX;
+
+    void reset() {
+        size_       = 0;
+        depth_      = 0;
+        refused_    = 0;
+        overflowed_ = false;
+    }
+
+    // Opens a bundle. Nested bundles are prefixed with their element size,
+    // which is patched by endBundle(). Returns the offset of the timetag so
+    // callers can patch it once the earliest sample in the bundle is known,
+    // or kNoRoom if the bundle was refused (endBundle() still pairs with it).
+    size_t beginBundle(uint64_t timeTag) {
+        const size_t needed = kBundleHeaderSize + (depth_ > 0 ? kElementPrefixSize : 0);
+        if (overflowed_ || depth_ == kMaxDepth || needed > remaining()) {
+            overflowed_ = true;
+            ++refused_;
+            return kNoRoom;
+        }
+        if (depth_ > 0) {
+            sizeSlots_[depth_] = size_;
+            size_ += kElementPrefixSize;
+        }
+        std::memcpy(buffer_.data() + size_, "#bundle", 8);
+        const size_t timeTagOffset = size_ + 8;
+        writeBigEndian64(buffer_.data() + timeTagOffset, timeTag);
+        size_ += kBundleHeaderSize;
+        ++depth_;
+        return timeTagOffset;
+    }
+
+    void endBundle() {
+        if (refused_ > 0) {
+            --refused_;
+            return;
+        }
+        if (depth_ == 0)
+            return;
+        --depth_;
+        if (depth_ > 0) {
+            const size_t slot = sizeSlots_[depth_];
+            writeBigEndian32(buffer_.data() + slot,
+                             static_cast<uint32_t>(size_ - slot - kElementPrefixSize));
+        }
+    }
+
+    void setTimeTag(size_t timeTagOffset, uint64_t timeTag) {
+        if (timeTagOffset != kNoRoom)
+            writeBigEndian64(buffer_.data() + timeTagOffset, timeTag);
+    }
+
+    // Appends a message; inside a bundle it gets a size prefix. Returns
+    // false, writing nothing, if it does not fit.
+    template <typename Message>
+    bool addMessage(const Message& message) {
+        const size_t needed = message.size() + (depth_ > 0 ? kElementPrefixSize : 0);
+        if (overflowed_ || refused_ > 0 || needed > remaining()) {
+            overflowed_ = true;
+            return false;
+        }
+        if (depth_ > 0) {
+            writeBigEndian32(buffer_.data() + size_, static_cast<uint32_t>(message.size()));
+            size_ += kElementPrefixSize;
+        }
+        std::memcpy(buffer_.data() + size_, message.data(), message.size());
+        size_ += message.size();
+        return true;
+    }
+
+    size_t remaining() const { return buffer_.size() - size_; }
+    bool empty() const { return size_ == 0; }
+    bool overflowed() const { return overflowed_; }
+    const uint8_t* data() const { return buffer_.data(); }
+    size_t size() const { return size_; }
+
+private:
+    std::array<uint8_t, kMaxPacketSize> buffer_{};
+    std::array<size_t, kMaxDepth>       sizeSlots_{};
+    size_t size_       = 0;
+    int    depth_      = 0;
+    int    refused_    = 0;       // open bundles that were refused
+    bool   overflowed_ = false;
+};
+
+// Owns one message template per (sensor, stream) and a packet builder.
+class OscPacketEncoder {
+public:
+    // Worst-case encoded size of one sample inside a nested frame bundle.
+    static constexpr size_t kMaxSampleSize =
+        OscPacketBuilder::kElementPrefixSize + OscPacketBuilder::kBundleHeaderSize +
+        OscPacketBuilder::kElementPrefixSize + OscMessageTemplate::kMaxSize;
+
+    // Builds all address strings and type tags. Call once the sensor count
+    // is known (at connect time), never from the streaming loop. `prefix`
+    // is prepended to every address (e.g. "/sync" gives "/sync/quat/0").
+    void prepare(int numSensors, const char* prefix = "") {
+        templates_.assign(static_cast<size_t>(numSensors) * kNumSensorStreams, {});
+        char address[48];
+        for (int sensor = 0; sensor < numSensors; ++sensor) {
+            for (int stream = 0; stream < kNumSensorStreams; ++stream) {
+                const auto s = static_cast<SensorStream>(stream);
+                std::snprintf(address, sizeof address, "%s%s/%d", prefix, streamAddressPrefix(s), sensor);
+                templates_[index(sensor, stream)].build(address, streamValueCount(s));
+            }
+        }
+    }
+
+    // Patches the template for this sample and returns it.
+    const OscMessageTemplate& encode(int sensor, const SensorSample& sample) {
+        auto& message = templates_[index(sensor, static_cast<int>(sample.stream))];
+        message.setValues(sample.values);
+        return message;
+    }
+
+    // Appends one sensor's samples to `builder` as a bundle (nested if the
+    // builder already has an open bundle). Samples sharing an epoch form one
+    // frame; if several frames are present each becomes a nested bundle with
+    // its own timetag. Returns the earliest epoch in the batch.
+    int64_t appendSensorBundle(OscPacketBuilder& builder, int sensor,
+                               const SensorSample* samples, size_t count) {
+        int64_t firstEpoch = samples[0].epoch;
+        bool singleFrame = true;
+        for (size_t i = 0; i < count; ++i) {
+            firstEpoch  = std::min(firstEpoch, samples[i].epoch);
+            singleFrame = singleFrame && samples[i].epoch == samples[0].epoch;
+        }
+
+        builder.beginBundle(timeTagFromEpochMs(firstEpoch));
+        size_t start = 0;
+        while (start < count) {
+            if (!singleFrame)
+                builder.beginBundle(timeTagFromEpochMs(samples[start].epoch));
+            size_t end = start;
+            while (end < count && samples[end].epoch == samples[start].epoch)
+                builder.addMessage(encode(sensor, samples[end++]));
+            if (!singleFrame)
+                builder.endBundle();
+            start = end;
+        }
+        builder.endBundle();
+        return firstEpoch;
+    }
+
+private:
+    static size_t index(int sensor, int stream) {
+        return static_cast<size_t>(sensor) * kNumSensorStreams + static_cast<size_t>(stream);
+    }
+
+    std::vector<OscMessageTemplate> templates_;
+};
+
+} // namespace osc
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "LatencyTracer.h"
+#include "OscPacketEncoder.h"
+#include "SensorSample.h"
+
+// ---------------------------------------------------------------------------
+// Per-destination stream routing.
+//
+// Each entry of config["servers"] may restrict what it receives:
+//     "streams": ["euler", "gyro"]   stream names (default: all)
+//     "sensors": [0, 2]              OSC sensor indices (default: all)
+//     "rate_hz": 30                  per-(sensor, stream) cap (default: every sample)
+//     "deadband": { "euler": 0.5 }   per-stream dead-band (default: config["deadband"])
+//     "keepalive_ms": 1000           resend the latest value after this long without
+//                                    a send (default: config["keepalive_ms"], 0 = off)
+// A sample inside the dead-band (every value within the given amount of the
+// last one sent for that sensor and stream) is held back. The keep-alive
+// resends the held value so receivers do not time out while a performer is
+// still.
+// Stage output (see StageSink) follows the same sensor and stream selection,
+// by the streams each message is derived from.
+// Destinations with identical filters share one OscRoute, so each distinct
+// selection is encoded once and handed to all of its destinations. The
+// table is compiled at startup; the streaming loop only tests bits and
+// compares epochs.
+// ---------------------------------------------------------------------------
+
+namespace osc {
+
+constexpr uint32_t kAllStreamsMask = (1u << kNumSensorStreams) - 1;
+
+struct OscRoute {
+    uint32_t          streamMask = kAllStreamsMask;
+    std::vector<bool> sensors;              // empty = every sensor
+    double            intervalMs = 0.0;     // 0 = no decimation
+    std::vector<int>  destinations;         // OscFanout indices
+
+    // Decimation state: next epoch due per (sensor, stream).
+    std::vector<double> nextDueMs;
+
+    // Change suppression, per stream (0 = off), and keep-alive interval.
+    std::array<float, kNumSensorStreams> deadband{};
+    double keepAliveMs = 0.0;
+
+    // Suppression state per (sensor, stream), when deadband or keep-alive is on.
+    struct Held {
+        SensorSample sent;            // last sample sent
+        SensorSample latest;          // newest sample seen, sent or not
+        int64_t      sentNs = 0;      // host time of the last send
+        bool         valid  = false;  // anything sent yet
+    };
+    std::vector<Held> held;
+
+    // AllSensors mode: the rig bundle being built for this route.
+    OscPacketBuilder builder;
+    size_t           rigTimeTagOffset = 0;
+    int64_t          rigEpoch = 0;
+
+    // Stage output (filters, orientation, features, aligner) for this route.
+    OscPacketBuilder stageBuilder;
+
+    // True if this route forwards every sample unchanged.
+    bool passesAll() const {
+        return streamMask == kAllStreamsMask && sensors.empty() && intervalMs <= 0.0 && held.empty();
+    }
+
+    bool wantsSensor(int sensor) const {
+        return sensors.empty()
+            || (sensor < static_cast<int>(sensors.size()) && sensors[static_cast<size_t>(sensor)]);
+    }
+
+    // True if stage output derived from any of the `sources` streams (bit
+    // per SensorStream) of `sensor` should be sent on this route.
+    bool wantsDerived(int sensor, uint32_t sources) const {
+        return (streamMask & sources) != 0 && wantsSensor(sensor);
+    }
+
+    // Streaming thread: true if `s` from `sensor` should be sent on this
+    // route. Advances the decimation clock when it is.
+    bool accept(int sensor, const SensorSample& s) {
+        if (!(streamMask & (1u << static_cast<int>(s.stream))))
+            return false;
+        const size_t slot = static_cast<size_t>(sensor * kNumSensorStreams + static_cast<int>(s.stream));
+
+        if (intervalMs > 0.0) {
+            double& due = nextDueMs[slot];
+            const double epoch = static_cast<double>(s.epoch);
+            if (epoch < due)
+                return false;
+            // Step by whole intervals so the average rate matches rate_hz; resync
+            // after a gap rather than bursting to catch up.
+            due = (epoch - due < intervalMs) ? due + intervalMs : epoch + intervalMs;
+        }
+
+        if (held.empty())
+            return true;
+        Held& h = held[slot];
+        h.latest = s;
+        if (h.valid && insideDeadband(h.sent, s))
+            return false;
+        h.sent   = s;
+        h.sentNs = latency::nowNs();
+        h.valid  = true;
+        return true;
+    }
+
+    // Streaming thread: calls send(sensor, sample) with the newest value of
+    // every (sensor, stream) that has not been sent for keepAliveMs.
+    template <typename Send>
+    void keepAlive(int64_t nowNs, Send&& send) {
+        if (keepAliveMs <= 0.0)
+            return;
+        const int64_t intervalNs = static_cast<int64_t>(keepAliveMs * 1e6);
+        for (size_t slot = 0; slot < held.size(); ++slot) {
+            Held& h = held[slot];
+            if (!h.valid || nowNs - h.sentNs < intervalNs)
+                continue;
+            h.sent   = h.latest;
+            h.sentNs = nowNs;
+            send(static_cast<int>(slot / kNumSensorStreams), h.latest);
+        }
+    }
+
+    bool sameFilter(const OscRoute& other) const {
+        return streamMask == other.streamMask && sensors == other.sensors && intervalMs == other.intervalMs
+            && deadband == other.deadband && keepAliveMs == other.keepAliveMs;
+    }
+
+private:
+    bool insideDeadband(const SensorSample& sent, const SensorSample& s) const {
+        const float band = deadband[static_cast<size_t>(s.stream)];
+        if (band <= 0.0f)
+            return false;
+        for (uint8_t k = 0; k < s.numValues; ++k)
+            if (std::fabs(s.values[k] - sent.values[k]) > band)
+                return false;
+        return true;
+    }
+};
+
+class OscRoutingTable {
+public:
+    // Adds destination `index` with the filters from its server entry,
+    // sharing an existing route when the filters match. `defaults` supplies
+    // the deadband and keepalive_ms a server entry does not set.
+    void addDestination(const nlohmann::json& server, int index, int numSensors,
+                        const nlohmann::json& defaults = nlohmann::json::object()) {
+        OscRoute route = compile(server, numSensors, defaults);
+        for (auto& existing : routes) {
+            if (existing.sameFilter(route)) {
+                existing.destinations.push_back(index);
+                return;
+            }
+        }
+        route.destinations.push_back(index);
+        routes.push_back(std::move(route));
+    }
+
+    std::vector<OscRoute>& all() { return routes; }
+    bool empty() const { return routes.empty(); }
+
+private:
+    static OscRoute compile(const nlohmann::json& server, int numSensors, const nlohmann::json& defaults) {
+        OscRoute route;
+
+        if (server.contains("streams")) {
+            route.streamMask = streamMaskFromJson(server["streams"], [](const std::string& name) {
+                juce::Logger::writeToLog("Unknown stream '" + juce::String(name) + "' in servers config, ignoring.");
+            });
+        }
+
+        if (server.contains("sensors")) {
+            route.sensors.assign(static_cast<size_t>(numSensors), false);
+            for (const auto& index : server["sensors"]) {
+                const int i = index.get<int>();
+                if (i >= 0 && i < numSensors)
+                    route.sensors[static_cast<size_t>(i)] = true;
+            }
+        }
+
+        const double rateHz = server.value("rate_hz", 0.0);
+        if (rateHz > 0.0) {
+            route.intervalMs = 1000.0 / rateHz;
+            route.nextDueMs.assign(static_cast<size_t>(numSensors * kNumSensorStreams), 0.0);
+        }
+
+        const auto& source = server.contains("deadband") ? server : defaults;
+        if (source.contains("deadband")) {
+            for (const auto& entry : source["deadband"].items()) {
+                SensorStream stream;
+                if (parseStreamName(entry.key(), stream))
+                    route.deadband[static_cast<size_t>(stream)] = entry.value().get<float>();
+                else
+                    juce::Logger::writeToLog("Unknown stream '" + juce::String(entry.key()) + "' in deadband config, ignoring.");
+            }
+        }
+        route.keepAliveMs = server.value("keepalive_ms", defaults.value("keepalive_ms", 0.0));
+
+        const bool suppressing = route.keepAliveMs > 0.0
+            || std::any_of(route.deadband.begin(), route.deadband.end(), [](float b) { return b > 0.0f; });
+        if (suppressing)
+            route.held.resize(static_cast<size_t>(numSensors * kNumSensorStreams));
+        return route;
+    }
+
+    std::vector<OscRoute> routes;
+};
+
+// Builds stage output per route. A stage emits one frame at a time:
+// begin(timeTag), add() for each message, end(). A message only goes to the
+// routes that want its sensor and at least one of the streams it was derived
+// from, and send(route, data, size) receives each route's bundles. Rate caps
+// and dead-bands are for raw samples and do not apply to stage output.
+template <typename Send>
+class StageSink {
+public:
+    StageSink(std::vector<OscRoute>& routesIn, Send sendIn) : routes(routesIn), send(std::move(sendIn)) {}
+
+    void begin(uint64_t timeTagIn) { timeTag = timeTagIn; }
+
+    template <typename Message>
+    void add(int sensor, uint32_t sources, const Message& message) {
+        for (auto& route : routes) {
+            if (!route.wantsDerived(sensor, sources))
+                continue;
+            auto& builder = route.stageBuilder;
+            // A frame too large for one datagram is split into several
+            // bundles with the same timetag.
+            if (!builder.empty() && builder.remaining() < OscPacketBuilder::kElementPrefixSize + message.size())
+                flush(route);
+            if (builder.empty())
+                builder.beginBundle(timeTag);
+            builder.addMessage(message);
+        }
+    }
+
+    void end() {
+        for (auto& route : routes)
+            flush(route);
+    }
+
+private:
+    void flush(OscRoute& route) {
+        auto& builder = route.stageBuilder;
+        if (builder.empty())
+            return;
+        builder.endBundle();
+        send(route, builder.data(), builder.size());
+        builder.reset();
+    }
+
+    std::vector<OscRoute>& routes;
+    Send                   send;
+    uint64_t               timeTag = 1;
+};
+
+template <typename Send>
+StageSink<Send> makeStageSink(std::vector<OscRoute>& routes, Send send) {
+    return StageSink<Send>(routes, std::move(send));
+}
+
+} // namespace osc
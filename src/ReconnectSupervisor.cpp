@@ -0,0 +1,108 @@
+//
+//  ReconnectSupervisor.cpp
+//
+//  Detects lost sensors and reconnects them without restarting the pipeline.
+//
+
+#include "ReconnectSupervisor.h"
+#include "ConnectionPool.h"
+
+ReconnectSupervisor::ReconnectSupervisor(BleInterface* bleIn, std::vector<MetaMotionController*> sensorsIn,
+                                         ConnectFn connectIn, const ReconnectOptions& optionsIn)
+    : ble(bleIn),
+      sensors(std::move(sensorsIn)),
+      connect(std::move(connectIn)),
+      options(optionsIn),
+      lostAt(sensors.size()),
+      released(sensors.size(), false)
+{
+}
+
+void ReconnectSupervisor::start() {
+    if (worker.joinable())
+        return;
+    stopping = false;
+    worker = std::thread([this] { run(); });
+}
+
+void ReconnectSupervisor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void ReconnectSupervisor::run() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(options.checkMs), [this] { return stopping; });
+            if (stopping)
+                return;
+        }
+
+        std::vector<size_t> lost;
+        for (size_t i = 0; i < sensors.size(); ++i)
+            if (sensors[i]->link_lost(options.silenceMs))
+                lost.push_back(i);
+        if (!lost.empty())
+            recover(lost);
+    }
+}
+
+void ReconnectSupervisor::recover(const std::vector<size_t>& lost) {
+    for (size_t i : lost) {
+        if (released[i])
+            continue;   // still missing from an earlier round
+        auto* c = sensors[i];
+        lostAt[i] = std::chrono::steady_clock::now();
+        juce::Logger::writeToLog(juce::String::formatted("Sensor %d (%s): link lost, reconnecting",
+                                                         (int)i, c->address.c_str()));
+        c->release_link();
+        if (ble)
+            ble->release(c->adapter);
+        released[i] = true;
+    }
+
+    // Joins every reconnect before the next check.
+    ConnectionPool pool(options.parallelism);
+
+    auto reconnect = [this, &pool](size_t i) {
+        released[i] = false;
+        auto* c = sensors[i];
+        const auto detected = lostAt[i];
+        pool.submit([this, c, i, detected] {
+            const bool ok = connect(c);
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - detected).count();
+            juce::Logger::writeToLog(juce::String::formatted("Sensor %d (%s): %s %lld ms after the link was lost",
+                                                             (int)i, c->address.c_str(),
+                                                             ok ? "recovered" : "reconnect failed", (long long)ms));
+        });
+    };
+
+    if (ble == nullptr) {
+        for (size_t i : lost) {
+            sensors[i]->prepare_reconnect(nullptr);
+            reconnect(i);
+        }
+        return;
+    }
+
+    // Rescan for just the missing boards; the scan ends as soon as all are seen.
+    std::vector<std::string> addresses;
+    for (size_t i : lost)
+        addresses.push_back(sensors[i]->address);
+
+    ble->scanForTargets(addresses, options.scanTimeoutMs, true,
+        [&](size_t target, const BleInterface::Sighting& s) {
+            auto* c = sensors[lost[target]];
+            c->adapter          = s.adapter;
+            c->sensorsOnAdapter = static_cast<int>(ble->adapterLoad[s.adapter]);
+            c->prepare_reconnect(std::make_unique<SimpleBleTransport>(s.peripheral));
+            reconnect(lost[target]);
+        });
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "BleInterface.h"
+#include "MetaMotionController.h"
+
+// ---------------------------------------------------------------------------
+// Background recovery of sensors that drop out.
+//
+// Every check_ms the supervisor looks for controllers whose link dropped (or
+// whose initialisation failed), releases their boards, rescans for just
+// those MACs and reconnects each one on the controller it had before, so
+// its sample queue and OSC index never change. Re-initialisation restores
+// the board state saved on first connect, which skips module discovery.
+//
+// config["reconnect"]:
+//     "enabled": true,          default true
+//     "check_ms": 500,          how often links are checked
+//     "scan_timeout_ms": 3000,  rescan budget per recovery round
+//     "silence_ms": 0           also treat this long without data as lost (0 = off)
+// ---------------------------------------------------------------------------
+
+struct ReconnectOptions {
+    bool enabled       = true;
+    int  checkMs       = 500;
+    int  scanTimeoutMs = 3000;
+    int  silenceMs     = 0;
+    int  parallelism   = 4;
+
+    static ReconnectOptions fromConfig(const nlohmann::json& config) {
+        ReconnectOptions options;
+        options.parallelism = config.value("connect_parallelism", options.parallelism);
+        if (config.contains("reconnect")) {
+            const auto& r = config["reconnect"];
+            options.enabled       = r.value("enabled", options.enabled);
+            options.checkMs       = std::max(50, r.value("check_ms", options.checkMs));
+            options.scanTimeoutMs = r.value("scan_timeout_ms", options.scanTimeoutMs);
+            options.silenceMs     = r.value("silence_ms", options.silenceMs);
+        }
+        return options;
+    }
+};
+
+class ReconnectSupervisor {
+public:
+    // Connects and initialises a prepared controller; true once it streams.
+    using ConnectFn = std::function<bool(MetaMotionController*)>;
+
+    // `ble` may be null (simulated boards): lost sensors then reconnect
+    // through their existing transport without a rescan.
+    ReconnectSupervisor(BleInterface* ble, std::vector<MetaMotionController*> sensors,
+                        ConnectFn connect, const ReconnectOptions& options);
+    ~ReconnectSupervisor() { stop(); }
+
+    void start();
+    void stop();
+
+private:
+    void run();
+    void recover(const std::vector<size_t>& lost);
+
+    BleInterface*                     ble;
+    std::vector<MetaMotionController*> sensors;   // indexed by OSC sensor index
+    ConnectFn                         connect;
+    ReconnectOptions                  options;
+
+    // Per sensor: when the loss was detected, and whether its adapter slot
+    // has been released and not yet reassigned by a rescan.
+    std::vector<std::chrono::steady_clock::time_point> lostAt;
+    std::vector<bool>                                  released;
+
+    std::thread             worker;
+    std::mutex              mutex;
+    std::condition_variable wake;
+    bool                    stopping = false;
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "BleInterface.h"
+#include "SensorSample.h"
+
+#include "metawear/sensor/sensor_fusion.h"
+
+// ---------------------------------------------------------------------------
+// Per-sensor board configuration.
+//
+// config["fusion"] holds the defaults for every sensor; its optional
+// "sensors" object overrides them per MAC address:
+//     "fusion": {
+//         "mode": "ndof",                        ndof | imu_plus | compass | m4g | raw
+//         "raw_odr_hz": 400,                     raw mode sample rate (25 - 1600 Hz)
+//         "acc_range": 4,                        2 | 4 | 8 | 16 (g)
+//         "gyro_range": 2000,                    250 | 500 | 1000 | 2000 (dps)
+//         "outputs": ["euler", "acc", "gyro", "mag"],
+//         "onboard": { "gyro": { "delta": 2 }, "acc": { "average": 4, "period_ms": 20 } },
+//         "sensors": { "AA:BB:CC:DD:EE:FF": { "mode": "imu_plus", "outputs": ["quat"] } }
+//     }
+// Output names are the stream address prefixes without the slash:
+// euler, acc, gyro, mag, quat, linacc. Streams that are not listed are
+// never enabled on the board, so they cost no BLE bandwidth.
+// config["orientation"] always enables quat (see OrientationStage), and
+// config["features"] acc and gyro (see FeatureStage).
+//
+// "raw" bypasses sensor fusion and streams the accelerometer and gyro
+// through their packed data signals (three samples per notification) at
+// raw_odr_hz, on the /acc and /gyro streams. Only the acc and gyro outputs
+// apply in raw mode.
+//
+// "onboard" builds MetaWear data processor chains on the board so that only
+// meaningful changes go over the air, per output:
+//     "average": n       running average over n samples (smoothing)
+//     "delta": x         only send when a value moved by more than x
+//     "period_ms": ms    send at most one sample per period (downsampling)
+// Stages run in that order. The firmware processors take 3-axis data only,
+// so chains apply to acc, gyro, mag and linacc; euler and quat (four
+// values) are ignored with a warning. A chain the firmware rejects falls
+// back to the plain fusion signal. Fusion outputs only; raw mode ignores it.
+//
+// BLE connection parameters come from config["connection"], and a per-sensor
+// entry may carry its own "connection" object:
+//     "connection": {
+//         "min_interval_ms": 7.5,  "max_interval_ms": 15,   7.5 - 4000 ms
+//         "latency": 0,                                     connection events the board may skip
+//         "timeout_ms": 6000,                               supervision timeout
+//         "auto_backoff": true, "backoff_sensors": 4        stretch intervals on a crowded adapter
+//     }
+// ---------------------------------------------------------------------------
+
+// Requested BLE connection parameters. An interval of 0 leaves the choice to
+// the central (raw IMU mode then asks for 7.5 ms).
+struct ConnectionParams {
+    float    minIntervalMs  = 0.0f;
+    float    maxIntervalMs  = 0.0f;
+    uint16_t latency        = 0;
+    uint16_t timeoutMs      = 6000;
+    bool     autoBackoff    = false;
+    int      backoffSensors = 4;   // sensors per adapter before intervals are stretched
+
+    bool requested() const { return minIntervalMs > 0.0f; }
+
+    void apply(const nlohmann::json& json) {
+        minIntervalMs  = json.value("min_interval_ms", minIntervalMs);
+        maxIntervalMs  = json.value("max_interval_ms", std::max(maxIntervalMs, minIntervalMs));
+        latency        = json.value("latency", latency);
+        timeoutMs      = json.value("timeout_ms", timeoutMs);
+        autoBackoff    = json.value("auto_backoff", autoBackoff);
+        backoffSensors = std::max(1, json.value("backoff_sensors", backoffSensors));
+        if (maxIntervalMs < minIntervalMs)
+            maxIntervalMs = minIntervalMs;
+    }
+};
+
+// On-board data processor chain for one output; zero disables a stage.
+struct OnboardChain {
+    uint8_t  averageSize = 0;
+    float    delta       = 0.0f;
+    uint32_t periodMs    = 0;
+
+    bool any() const { return averageSize > 0 || delta > 0.0f || periodMs > 0; }
+
+    // Streams whose fusion signal the average and delta processors accept.
+    static bool supports(SensorStream stream) {
+        return stream == SensorStream::Acc || stream == SensorStream::Gyro
+            || stream == SensorStream::Mag || stream == SensorStream::LinAcc;
+    }
+
+    void apply(const nlohmann::json& json) {
+        averageSize = static_cast<uint8_t>(std::clamp(json.value("average", static_cast<int>(averageSize)), 0, 255));
+        delta       = json.value("delta", delta);
+        periodMs    = json.value("period_ms", periodMs);
+    }
+};
+
+struct SensorConfig {
+    MblMwSensorFusionMode      fusionMode   = MBL_MW_SENSOR_FUSION_MODE_NDOF;
+    MblMwSensorFusionAccRange  accRange     = MBL_MW_SENSOR_FUSION_ACC_RANGE_4G;
+    MblMwSensorFusionGyroRange gyroRange    = MBL_MW_SENSOR_FUSION_GYRO_RANGE_2000DPS;
+    int                        accRangeG    = 4;      // the same ranges, for raw mode
+    int                        gyroRangeDps = 2000;
+
+    bool  rawImu   = false;
+    float rawOdrHz = 400.0f;
+
+    ConnectionParams connection;
+
+    // Per SensorStream.
+    std::array<OnboardChain, kNumSensorStreams> onboard{};
+
+    // Bit per SensorStream.
+    uint32_t outputs = (1u << static_cast<int>(SensorStream::Euler))
+                     | (1u << static_cast<int>(SensorStream::Acc))
+                     | (1u << static_cast<int>(SensorStream::Gyro))
+                     | (1u << static_cast<int>(SensorStream::Mag));
+
+    bool enabled(SensorStream stream) const { return outputs & (1u << static_cast<int>(stream)); }
+
+    // Applies the keys present in `json` on top of this config.
+    void apply(const nlohmann::json& json) {
+        if (json.contains("mode")) {
+            const auto mode = json["mode"].get<std::string>();
+            rawImu = mode == "raw";
+            if      (mode == "ndof")     fusionMode = MBL_MW_SENSOR_FUSION_MODE_NDOF;
+            else if (mode == "imu_plus") fusionMode = MBL_MW_SENSOR_FUSION_MODE_IMU_PLUS;
+            else if (mode == "compass")  fusionMode = MBL_MW_SENSOR_FUSION_MODE_COMPASS;
+            else if (mode == "m4g")      fusionMode = MBL_MW_SENSOR_FUSION_MODE_M4G;
+            else if (!rawImu) juce::Logger::writeToLog("Unknown fusion mode '" + juce::String(mode) + "', ignoring.");
+        }
+
+        if (json.contains("raw_odr_hz"))
+            rawOdrHz = json["raw_odr_hz"].get<float>();
+
+        if (json.contains("acc_range")) {
+            const int g = json["acc_range"].get<int>();
+            switch (g) {
+                case 2:  accRange = MBL_MW_SENSOR_FUSION_ACC_RANGE_2G;  accRangeG = g; break;
+                case 4:  accRange = MBL_MW_SENSOR_FUSION_ACC_RANGE_4G;  accRangeG = g; break;
+                case 8:  accRange = MBL_MW_SENSOR_FUSION_ACC_RANGE_8G;  accRangeG = g; break;
+                case 16: accRange = MBL_MW_SENSOR_FUSION_ACC_RANGE_16G; accRangeG = g; break;
+                default: juce::Logger::writeToLog("Unsupported fusion acc_range, ignoring."); break;
+            }
+        }
+
+        if (json.contains("gyro_range")) {
+            const int dps = json["gyro_range"].get<int>();
+            switch (dps) {
+                case 250:  gyroRange = MBL_MW_SENSOR_FUSION_GYRO_RANGE_250DPS;  gyroRangeDps = dps; break;
+                case 500:  gyroRange = MBL_MW_SENSOR_FUSION_GYRO_RANGE_500DPS;  gyroRangeDps = dps; break;
+                case 1000: gyroRange = MBL_MW_SENSOR_FUSION_GYRO_RANGE_1000DPS; gyroRangeDps = dps; break;
+                case 2000: gyroRange = MBL_MW_SENSOR_FUSION_GYRO_RANGE_2000DPS; gyroRangeDps = dps; break;
+                default: juce::Logger::writeToLog("Unsupported fusion gyro_range, ignoring."); break;
+            }
+        }
+
+        if (json.contains("outputs")) {
+            outputs = streamMaskFromJson(json["outputs"], [](const std::string& name) {
+                juce::Logger::writeToLog("Unknown fusion output '" + juce::String(name) + "', ignoring.");
+            });
+        }
+
+        if (json.contains("onboard")) {
+            for (const auto& entry : json["onboard"].items()) {
+                SensorStream stream;
+                if (!parseStreamName(entry.key(), stream))
+                    juce::Logger::writeToLog("Unknown onboard output '" + juce::String(entry.key()) + "', ignoring.");
+                else if (!OnboardChain::supports(stream))
+                    juce::Logger::writeToLog("On-board processors take 3-axis outputs only, ignoring '"
+                                             + juce::String(entry.key()) + "'.");
+                else
+                    onboard[static_cast<size_t>(stream)].apply(entry.value());
+            }
+        }
+
+        if (json.contains("connection"))
+            connection.apply(json["connection"]);
+    }
+
+    // Config for the sensor at `address`: the "fusion" and "connection"
+    // defaults plus any override under fusion.sensors[address].
+    static SensorConfig forAddress(const nlohmann::json& config, const std::string& address) {
+        SensorConfig result;
+        if (config.contains("connection"))
+            result.connection.apply(config["connection"]);
+        if (config.contains("fusion")) {
+            const auto& fusion = config["fusion"];
+            result.apply(fusion);
+            if (fusion.contains("sensors")) {
+                const auto wanted = BleInterface::normaliseAddress(address);
+                for (const auto& entry : fusion["sensors"].items())
+                    if (BleInterface::normaliseAddress(entry.key()) == wanted)
+                        result.apply(entry.value());
+            }
+        }
+        // The orientation stage works on the fusion quaternion.
+        if (config.contains("orientation") && !result.rawImu)
+            result.outputs |= 1u << static_cast<int>(SensorStream::Quat);
+        // The feature windows are built from acc and gyro.
+        if (config.contains("features"))
+            result.outputs |= (1u << static_cast<int>(SensorStream::Acc))
+                            | (1u << static_cast<int>(SensorStream::Gyro));
+        result.dropUnfusedOutputs(address);
+        return result;
+    }
+
+    // NDOF fuses accelerometer, gyro and magnetometer; IMU_PLUS drops the
+    // magnetometer, COMPASS and M4G drop the gyro. Corrected outputs of a
+    // sensor the mode does not use are never produced, so they are disabled
+    // here, once, rather than while the board initialises.
+    void dropUnfusedOutputs(const std::string& address) {
+        if (rawImu)
+            return;
+        SensorStream stream;
+        const char*  mode;
+        switch (fusionMode) {
+            case MBL_MW_SENSOR_FUSION_MODE_IMU_PLUS: stream = SensorStream::Mag;  mode = "IMU_PLUS"; break;
+            case MBL_MW_SENSOR_FUSION_MODE_COMPASS:  stream = SensorStream::Gyro; mode = "COMPASS";  break;
+            case MBL_MW_SENSOR_FUSION_MODE_M4G:      stream = SensorStream::Gyro; mode = "M4G";      break;
+            default: return;
+        }
+        if (!enabled(stream))
+            return;
+        outputs &= ~(1u << static_cast<int>(stream));
+        juce::Logger::writeToLog(juce::String::formatted("[%s] %s output is not available in %s mode, disabled",
+                                                         address.c_str(), streamAddressPrefix(stream) + 1, mode));
+    }
+};
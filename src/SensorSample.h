@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Data streams produced by a MetaMotionController. Also used as an index
+// into per-stream tables on the OSC side.
+enum class SensorStream : uint8_t {
+    Euler = 0,   // heading/yaw, pitch, roll, yaw/heading
+    Acc,         // corrected acceleration (x, y, z)
+    Gyro,        // corrected gyroscope (x, y, z)
+    Mag,         // corrected magnetometer (x, y, z)
+    Quat,        // orientation quaternion (w, x, y, z)
+    LinAcc,      // linear acceleration, gravity removed (x, y, z)
+    Count
+};
+
+constexpr int kNumSensorStreams = static_cast<int>(SensorStream::Count);
+
+// OSC address prefix of each stream; the sensor index is appended.
+inline const char* streamAddressPrefix(SensorStream stream) {
+    static const char* const prefixes[kNumSensorStreams] = { "/euler", "/acc", "/gyro", "/mag", "/quat", "/linacc" };
+    return prefixes[static_cast<int>(stream)];
+}
+
+// Stream named in config by its address prefix without the slash ("acc").
+// Returns false, leaving `stream` untouched, if the name is unknown.
+inline bool parseStreamName(const std::string& name, SensorStream& stream) {
+    for (int s = 0; s < kNumSensorStreams; ++s) {
+        if (name == streamAddressPrefix(static_cast<SensorStream>(s)) + 1) {
+            stream = static_cast<SensorStream>(s);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bit per SensorStream for a config array of stream names. Each unknown
+// name is passed to onUnknown(name) and left out.
+template <typename Names, typename OnUnknown>
+uint32_t streamMaskFromJson(const Names& names, OnUnknown&& onUnknown) {
+    uint32_t mask = 0;
+    for (const auto& entry : names) {
+        const auto name = entry.template get<std::string>();
+        SensorStream stream;
+        if (parseStreamName(name, stream))
+            mask |= 1u << static_cast<int>(stream);
+        else
+            onUnknown(name);
+    }
+    return mask;
+}
+
+// Number of float values carried by each stream.
+inline int streamValueCount(SensorStream stream) {
+    static const int counts[kNumSensorStreams] = { 4, 3, 3, 3, 4, 3 };
+    return counts[static_cast<int>(stream)];
+}
+
+// One timestamped reading from a single sensor stream, as queued from the
+// MetaWear data callbacks to the OSC streaming thread.
+struct SensorSample {
+    uint64_t     sequence  = 0;   // per-controller sample counter (SensorFrame::sequence)
+    int64_t      epoch     = 0;   // MetaWear sample epoch (ms since Unix epoch)
+    SensorStream stream    = SensorStream::Euler;
+    uint8_t      numValues = 0;
+    float        values[4] = {};
+
+    // Host steady-clock stamps (ns) for latency tracing; 0 = not stamped.
+    int64_t      notifyNs   = 0;  // BLE notification arrived
+    int64_t      callbackNs = 0;  // SDK data callback entered
+    int64_t      handoffNs  = 0;  // snapshot published, about to queue
+};
+
+// Latest value of every stream of one sensor. Published through a Seqlock
+// by the MetaWear callbacks so readers always see a consistent frame.
+struct SensorFrame {
+    uint64_t sequence = 0;                          // bumped on every sample
+    int64_t  epoch    = 0;                          // epoch of the newest sample
+    int64_t  streamEpoch[kNumSensorStreams] = {};   // epoch of each stream's newest sample
+
+    float euler[4]  = {};   // [heading/yaw, pitch, roll, yaw/heading]
+    float acc[3]    = {};   // corrected acceleration (x, y, z)
+    float gyro[3]   = {};   // corrected gyroscope (x, y, z)
+    float mag[3]    = {};   // corrected magnetometer (x, y, z)
+    float quat[4]   = {};   // orientation quaternion (w, x, y, z)
+    float linAcc[3] = {};   // linear acceleration (x, y, z)
+
+    float* values(SensorStream stream) {
+        switch (stream) {
+            case SensorStream::Euler:  return euler;
+            case SensorStream::Acc:    return acc;
+            case SensorStream::Gyro:   return gyro;
+            case SensorStream::Quat:   return quat;
+            case SensorStream::LinAcc: return linAcc;
+            default:                   return mag;
+        }
+    }
+    const float* values(SensorStream stream) const {
+        return const_cast<SensorFrame*>(this)->values(stream);
+    }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock for small trivially copyable values.
+//
+// The writer never blocks: it bumps the sequence to odd, stores the value
+// and bumps it back to even. Readers copy the value and retry if the
+// sequence changed underneath them, so they always observe a complete,
+// untorn value. The payload is stored as relaxed atomic words to keep the
+// concurrent copy well defined.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock requires a trivially copyable type");
+
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    Seqlock() { store(T{}); }
+
+    // Writer side only (one thread at a time).
+    void store(const T& value) {
+        uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i)
+            words_[i].store(words[i], std::memory_order_relaxed);
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Safe from any thread; spins only while a write is in flight.
+    T load() const {
+        uint64_t words[kWords];
+        for (;;) {
+            const uint32_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1u)
+                continue;
+            for (size_t i = 0; i < kWords; ++i)
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before)
+                break;
+        }
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    std::atomic<uint32_t> sequence_{0};
+    std::array<std::atomic<uint64_t>, kWords> words_{};
+};
@@ -0,0 +1,231 @@
+//
+//  SessionRecording.cpp
+//
+//  Fixed-record binary capture of the sample stream (--record) and timed
+//  playback of a capture through the normal OSC pipeline (--replay).
+//
+
+#include "SessionRecording.h"
+#include "LatencyTracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+constexpr char kSessionMagic[8] = { 'M', 'O', 'S', 'C', 'R', 'E', 'C', '1' };
+
+int64_t wallClockMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// SessionRecorder
+// ---------------------------------------------------------------------------
+
+bool SessionRecorder::open(const std::string& path) {
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    SessionFileHeader header{};
+    std::memcpy(header.magic, kSessionMagic, sizeof header.magic);
+    header.version    = kSessionFileVersion;
+    header.recordSize = sizeof(SessionRecord);
+    header.startEpoch = wallClockMs();
+    if (std::fwrite(&header, sizeof header, 1, file) != 1) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    queue.clear();
+    sensorCount = 0;
+    sensorCountForHeader.store(0);
+    droppedRecords.store(0);
+    startNs = latency::nowNs();
+    running = true;
+    writer = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void SessionRecorder::close() {
+    if (!running.exchange(false))
+        return;
+    if (writer.joinable())
+        writer.join();
+
+    // Patch the sensor count now that every record is on disk.
+    const uint32_t count = sensorCountForHeader.load();
+    std::fseek(file, static_cast<long>(offsetof(SessionFileHeader, sensorCount)), SEEK_SET);
+    std::fwrite(&count, sizeof count, 1, file);
+    std::fclose(file);
+    file = nullptr;
+}
+
+void SessionRecorder::record(int sensor, const SensorSample& sample) {
+    if (!running.load(std::memory_order_relaxed))
+        return;
+
+    SessionRecord r{};
+    r.epoch     = sample.epoch;
+    r.hostNs    = (sample.handoffNs != 0 ? sample.handoffNs : latency::nowNs()) - startNs;
+    r.sequence  = static_cast<uint32_t>(sample.sequence);
+    r.sensor    = static_cast<uint16_t>(sensor);
+    r.stream    = static_cast<uint8_t>(sample.stream);
+    r.numValues = sample.numValues;
+    std::memcpy(r.values, sample.values, sizeof r.values);
+
+    if (!queue.push(r)) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (static_cast<uint32_t>(sensor) >= sensorCount) {
+        sensorCount = static_cast<uint32_t>(sensor) + 1;
+        sensorCountForHeader.store(sensorCount, std::memory_order_relaxed);
+    }
+}
+
+void SessionRecorder::writerLoop() {
+    constexpr size_t kBatch = 512;
+    SessionRecord batch[kBatch];
+
+    for (;;) {
+        // Read `running` before draining so the final pass sees every record
+        // pushed before close().
+        const bool keepGoing = running.load();
+
+        size_t n = 0;
+        while (n < kBatch && queue.pop(batch[n]))
+            ++n;
+        if (n > 0)
+            std::fwrite(batch, sizeof(SessionRecord), n, file);
+
+        if (n == kBatch)
+            continue;
+        if (!keepGoing && queue.empty())
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::fflush(file);
+}
+
+// ---------------------------------------------------------------------------
+// SessionReplay
+// ---------------------------------------------------------------------------
+
+bool SessionReplay::open(const std::string& path) {
+    stop();
+    queues.clear();
+    records = nullptr;
+    numRecords = 0;
+
+    const juce::File source(juce::File::getCurrentWorkingDirectory().getChildFile(path));
+    mapped = std::make_unique<juce::MemoryMappedFile>(source, juce::MemoryMappedFile::readOnly);
+    if (mapped->getData() == nullptr || mapped->getSize() < sizeof(SessionFileHeader)) {
+        juce::Logger::writeToLog("Replay: cannot map " + source.getFullPathName());
+        return false;
+    }
+
+    const auto* base = static_cast<const uint8_t*>(mapped->getData());
+    SessionFileHeader header;
+    std::memcpy(&header, base, sizeof header);
+    if (std::memcmp(header.magic, kSessionMagic, sizeof header.magic) != 0
+        || header.version != kSessionFileVersion
+        || header.recordSize != sizeof(SessionRecord)) {
+        juce::Logger::writeToLog("Replay: " + source.getFileName() + " is not a MetaOSC session file");
+        return false;
+    }
+
+    records    = reinterpret_cast<const SessionRecord*>(base + sizeof header);
+    numRecords = (mapped->getSize() - sizeof header) / sizeof(SessionRecord);
+
+    // The header count is only patched on a clean close; derive it from the
+    // records if the recorder did not get that far.
+    uint32_t sensors = header.sensorCount;
+    if (sensors == 0)
+        for (size_t i = 0; i < numRecords; ++i)
+            sensors = std::max<uint32_t>(sensors, records[i].sensor + 1u);
+
+    for (uint32_t i = 0; i < sensors; ++i)
+        queues.push_back(std::make_unique<SampleQueue>());
+
+    juce::Logger::writeToLog(juce::String::formatted("Replay: %d record(s) from %d sensor(s)",
+                                                     (int) numRecords, (int) sensors));
+    return true;
+}
+
+void SessionReplay::start(bool asFastAsPossible, std::function<void()> onSample,
+                          std::function<void()> onFinished) {
+    stop();
+    fast             = asFastAsPossible;
+    sampleCallback   = std::move(onSample);
+    finishedCallback = std::move(onFinished);
+    running = true;
+    worker = std::thread([this] { run(); });
+}
+
+void SessionReplay::stop() {
+    if (!running.exchange(false))
+        return;
+    if (worker.joinable() && worker.get_id() != std::this_thread::get_id())
+        worker.join();
+}
+
+void SessionReplay::run() {
+    const int64_t startNs = latency::nowNs();
+    const int64_t firstNs = numRecords > 0 ? records[0].hostNs : 0;
+
+    for (size_t i = 0; i < numRecords && running.load(); ++i) {
+        const SessionRecord& r = records[i];
+        if (r.sensor >= queues.size())
+            continue;
+
+        if (!fast) {
+            const int64_t due = startNs + (r.hostNs - firstNs);
+            const int64_t wait = due - latency::nowNs();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        }
+
+        SensorSample s{};
+        s.sequence  = r.sequence;
+        s.epoch     = r.epoch;
+        s.stream    = static_cast<SensorStream>(std::min<uint8_t>(r.stream, kNumSensorStreams - 1));
+        s.numValues = std::min<uint8_t>(r.numValues, 4);
+        std::memcpy(s.values, r.values, sizeof s.values);
+        s.handoffNs = latency::nowNs();   // notify/callback stay 0: not traced
+
+        SampleQueue& q = *queues[r.sensor];
+        while (!q.push(s)) {
+            // Consumer is behind; in fast mode this is the normal pacing.
+            if (sampleCallback)
+                sampleCallback();
+            if (!running.load())
+                return;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        if (sampleCallback)
+            sampleCallback();
+    }
+
+    // Let the streaming thread drain the tail before reporting completion.
+    for (auto& q : queues)
+        while (running.load() && !q->empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const double seconds = (latency::nowNs() - startNs) * 1e-9;
+    juce::Logger::writeToLog(juce::String::formatted("Replay: finished %d record(s) in %.2f s (%.0f samples/s)",
+                                                     (int) numRecords, seconds,
+                                                     seconds > 0.0 ? numRecords / seconds : 0.0));
+    if (running.load() && finishedCallback)
+        finishedCallback();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SensorSample.h"
+#include "SpscQueue.h"
+
+// ---------------------------------------------------------------------------
+// Binary session recording and replay.
+//
+// File layout (host byte order, little-endian on all supported platforms):
+//     SessionFileHeader               32 bytes
+//     SessionRecord[n]                40 bytes each
+// Records are fixed size so the file can be memory-mapped and indexed
+// directly. hostNs is the handoff time relative to the start of recording
+// and drives replay at original timing.
+// ---------------------------------------------------------------------------
+
+struct SessionFileHeader {
+    char     magic[8];      // "MOSCREC1"
+    uint32_t version;       // kSessionFileVersion
+    uint32_t recordSize;    // sizeof(SessionRecord)
+    uint32_t sensorCount;   // highest sensor index + 1
+    uint32_t reserved;
+    int64_t  startEpoch;    // wall clock at start of recording (ms since Unix epoch)
+};
+
+struct SessionRecord {
+    int64_t  epoch;         // MetaWear sample epoch (ms since Unix epoch)
+    int64_t  hostNs;        // host handoff time since recording start
+    uint32_t sequence;      // low 32 bits of SensorSample::sequence
+    uint16_t sensor;        // OSC index
+    uint8_t  stream;        // SensorStream
+    uint8_t  numValues;
+    float    values[4];
+};
+
+static_assert(sizeof(SessionFileHeader) == 32, "SessionFileHeader layout changed");
+static_assert(sizeof(SessionRecord) == 40, "SessionRecord layout changed");
+
+constexpr uint32_t kSessionFileVersion = 1;
+
+// Appends samples to a session file. record() is called from the streaming
+// thread and only pushes into a lock-free queue; a background thread does
+// the file I/O and patches the sensor count into the header on close.
+class SessionRecorder {
+public:
+    SessionRecorder() = default;
+    ~SessionRecorder() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    // Streaming thread only. Never blocks; drops the record if the writer
+    // has fallen a full queue behind.
+    void record(int sensor, const SensorSample& sample);
+
+    uint64_t dropped() const { return droppedRecords.load(std::memory_order_relaxed); }
+
+private:
+    void writerLoop();
+
+    std::FILE*                         file = nullptr;
+    SpscQueue<SessionRecord, 1 << 16>  queue;
+    std::thread                        writer;
+    std::atomic<bool>                  running{false};
+    std::atomic<uint64_t>              droppedRecords{0};
+    uint32_t                           sensorCount = 0;   // streaming thread
+    std::atomic<uint32_t>              sensorCountForHeader{0};
+    int64_t                            startNs = 0;
+};
+
+// Replays a memory-mapped session file into per-sensor sample queues, either
+// at the recorded timing or as fast as the consumer drains them.
+class SessionReplay {
+public:
+    using SampleQueue = SpscQueue<SensorSample, 1024>;
+
+    ~SessionReplay() { stop(); }
+
+    bool open(const std::string& path);
+    int  sensorCount() const { return static_cast<int>(queues.size()); }
+    SampleQueue& queue(int sensor) { return *queues[static_cast<size_t>(sensor)]; }
+
+    // `onSample` wakes the consumer; `onFinished` runs on the replay thread
+    // once every record has been queued and consumed.
+    void start(bool asFastAsPossible, std::function<void()> onSample,
+               std::function<void()> onFinished);
+    void stop();
+
+private:
+    void run();
+
+    std::unique_ptr<juce::MemoryMappedFile>   mapped;
+    const SessionRecord*                      records = nullptr;
+    size_t                                    numRecords = 0;
+    std::vector<std::unique_ptr<SampleQueue>> queues;
+
+    bool                  fast = false;
+    std::function<void()> sampleCallback;
+    std::function<void()> finishedCallback;
+    std::thread           worker;
+    std::atomic<bool>     running{false};
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "LatencyTracer.h"
+#include "SensorSample.h"
+#include "metaosc_shm.h"
+
+// ---------------------------------------------------------------------------
+// Shared-memory output for consumers on the same machine.
+//
+// Every drained sample is written as a 64-byte record into the ring in
+// shm/metaosc_shm.h, and each pass of the streaming loop ends with one
+// commit that publishes the batch and wakes sleeping readers. Nothing is
+// serialised and no socket is involved; the OSC outputs are unaffected.
+// POSIX only (Linux and macOS).
+//
+// config["shm"]:
+//     "name": "/metaosc",     shared-memory object name
+//     "capacity": 65536       records in the ring (rounded up to a power of two)
+// ---------------------------------------------------------------------------
+
+#if METAOSC_SHM_SUPPORTED
+static_assert(static_cast<int>(SensorStream::Euler)  == METAOSC_STREAM_EULER
+           && static_cast<int>(SensorStream::Acc)    == METAOSC_STREAM_ACC
+           && static_cast<int>(SensorStream::Gyro)   == METAOSC_STREAM_GYRO
+           && static_cast<int>(SensorStream::Mag)    == METAOSC_STREAM_MAG
+           && static_cast<int>(SensorStream::Quat)   == METAOSC_STREAM_QUAT
+           && static_cast<int>(SensorStream::LinAcc) == METAOSC_STREAM_LINACC,
+              "metaosc_stream must match SensorStream");
+#endif
+
+class SharedMemoryOutput {
+public:
+    ~SharedMemoryOutput() { close(); }
+
+    // Creates the ring. Returns false (and logs why) if it cannot.
+    bool open(const nlohmann::json& shm, int numSensors) {
+#if METAOSC_SHM_SUPPORTED
+        const auto name     = shm.value("name", std::string("/metaosc"));
+        const auto capacity = shm.value("capacity", 65536u);
+        if (metaosc_shm_create(&ring, name.c_str(), capacity, static_cast<uint32_t>(numSensors)) != 0) {
+            juce::Logger::writeToLog("Could not create shared memory " + juce::String(name) + ": " + std::strerror(errno));
+            return false;
+        }
+        juce::Logger::writeToLog(juce::String::formatted("Publishing samples to shared memory %s (%u records)",
+                                                         name.c_str(), ring.header->capacity));
+        active = true;
+        return true;
+#else
+        juce::Logger::writeToLog("Shared-memory output is not available on this platform.");
+        return false;
+#endif
+    }
+
+    bool enabled() const { return active; }
+
+    // Streaming thread: writes one record; readers see it after commit().
+    void publish(int sensor, const SensorSample& sample) {
+#if METAOSC_SHM_SUPPORTED
+        metaosc_shm_record record{};
+        record.epoch_ms   = sample.epoch;
+        record.host_ns    = latency::nowNs();
+        record.sequence   = sample.sequence;
+        record.sensor     = static_cast<uint32_t>(sensor);
+        record.stream     = static_cast<uint8_t>(sample.stream);
+        record.num_values = sample.numValues;
+        std::memcpy(record.values, sample.values, sizeof record.values);
+        metaosc_shm_write(&ring, &record);
+#endif
+    }
+
+    // Streaming thread: publishes everything written this pass.
+    void commit() {
+#if METAOSC_SHM_SUPPORTED
+        metaosc_shm_commit(&ring);
+#endif
+    }
+
+    // Marks the ring closed so readers stop waiting, and removes its name.
+    void close() {
+#if METAOSC_SHM_SUPPORTED
+        if (active)
+            metaosc_shm_destroy(&ring);
+#endif
+        active = false;
+    }
+
+private:
+    metaosc_shm ring{};
+    bool        active = false;
+};
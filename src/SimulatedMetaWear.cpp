@@ -0,0 +1,399 @@
+//
+//  SimulatedMetaWear.cpp
+//
+//  A software MetaMotion R used to load-test the OSC pipeline. Protocol
+//  constants follow the MetaWear GATT command format:
+//      [module id, register (| 0x80 for reads), payload...]
+//
+
+#include "SimulatedMetaWear.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// Protocol constants
+// ---------------------------------------------------------------------------
+
+namespace {
+
+constexpr uint8_t kReadBit          = 0x80;
+constexpr uint8_t kInfoRegister     = 0x80;   // module discovery: [module, 0x80]
+
+constexpr uint8_t kModuleAcc        = 0x03;
+constexpr uint8_t kModuleGyro       = 0x13;
+constexpr uint8_t kModuleProcessor  = 0x09;
+constexpr uint8_t kModuleSettings   = 0x11;
+constexpr uint8_t kModuleFusion     = 0x19;
+constexpr uint8_t kSettingsBattery  = 0x0c;
+constexpr uint8_t kFusionEnable     = 0x01;
+constexpr uint8_t kFusionOutput     = 0x03;
+constexpr uint8_t kFusionFirstData  = 0x04;   // corrected acc; outputs follow in MblMwSensorFusionData order
+
+// Data processor
+constexpr uint8_t kProcessorAdd     = 0x02;   // [source module, register, id, ...config] -> [new id]
+constexpr uint8_t kProcessorNotify  = 0x03;   // output: [id, data...]
+constexpr uint8_t kProcessorRemove  = 0x06;   // [id]
+
+// Bosch accelerometer / gyro (BMI160 register layout)
+constexpr uint8_t kImuPowerMode     = 0x01;   // [1] start, [0] stop
+constexpr uint8_t kImuConfig        = 0x03;   // [odr code | bandwidth, range code]
+constexpr uint8_t kAccPackedData    = 0x1c;
+constexpr uint8_t kGyroPackedData   = 0x07;
+constexpr int     kPackedSamples    = 3;
+
+// Bosch ODR codes: rate = 100 Hz * 2^(code - 8).
+double boschOdrHz(uint8_t code) {
+    return 100.0 * std::pow(2.0, static_cast<int>(code & 0x0f) - 8);
+}
+
+// Module discovery responses for a MetaMotion R: implementation, revision
+// and any extra bytes. Modules not listed answer as absent ([id, 0x80]).
+struct ModuleInfo {
+    uint8_t id;
+    uint8_t bytes[4];
+    uint8_t length;
+};
+
+const ModuleInfo kModules[] = {
+    { 0x01, { 0x00, 0x00 },             2 },  // switch
+    { 0x02, { 0x00, 0x00 },             2 },  // LED
+    { 0x03, { 0x01, 0x01 },             2 },  // accelerometer (BMI160)
+    { 0x09, { 0x00, 0x02, 0x1c },       3 },  // data processor
+    { 0x11, { 0x00, 0x06, 0x03 },       3 },  // settings (power + charge status)
+    { 0x13, { 0x00, 0x01 },             2 },  // gyro (BMI160)
+    { 0x15, { 0x00, 0x01 },             2 },  // magnetometer (BMM150)
+    { 0x19, { 0x00, 0x00 },             2 },  // sensor fusion
+    { 0xfe, { 0x00, 0x00 },             2 },  // debug
+};
+
+bool hasPrefix(const std::string& s, const char* prefix) {
+    return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+void appendFloats(std::vector<uint8_t>& packet, std::initializer_list<float> values) {
+    for (float v : values) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &v, 4);   // MetaWear payloads are little-endian
+        packet.insert(packet.end(), bytes, bytes + 4);
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Construction / connection
+// ---------------------------------------------------------------------------
+
+SimulatedMetaWearTransport::SimulatedMetaWearTransport(int indexIn, double rateHzIn)
+    : index(indexIn), rateHz(rateHzIn > 0.0 ? rateHzIn : 100.0)
+{
+    rawAcc.module          = kModuleAcc;
+    rawAcc.packedRegister  = kAccPackedData;
+    rawAcc.lsbPerUnit      = 16384.0f / 2.0f;   // +-2 g power-on default
+    rawGyro.module         = kModuleGyro;
+    rawGyro.packedRegister = kGyroPackedData;
+    rawGyro.lsbPerUnit     = 16.4f;             // +-2000 deg/s
+}
+
+SimulatedMetaWearTransport::~SimulatedMetaWearTransport() {
+    disconnect();
+}
+
+std::string SimulatedMetaWearTransport::address() {
+    char address[18];
+    std::snprintf(address, sizeof address, "5A:00:00:00:%02X:%02X",
+                  (index >> 8) & 0xff, index & 0xff);
+    return address;
+}
+
+void SimulatedMetaWearTransport::connect() {
+    if (running.exchange(true))
+        return;
+    start = std::chrono::steady_clock::now();
+    connected = true;
+    worker = std::thread([this] { run(); });
+}
+
+void SimulatedMetaWearTransport::disconnect() {
+    if (!running.exchange(false))
+        return;
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+    connected = false;
+}
+
+// ---------------------------------------------------------------------------
+// GATT operations
+// ---------------------------------------------------------------------------
+
+std::vector<uint8_t> SimulatedMetaWearTransport::read(const std::string& /*service*/,
+                                                      const std::string& characteristic) {
+    std::string value;
+    if      (hasPrefix(characteristic, "00002a26")) value = "1.5.0";           // firmware revision
+    else if (hasPrefix(characteristic, "00002a24")) value = "5";               // model number: MetaMotion R
+    else if (hasPrefix(characteristic, "00002a27")) value = "0.4";             // hardware revision
+    else if (hasPrefix(characteristic, "00002a29")) value = "MbientLab Inc";   // manufacturer
+    else if (hasPrefix(characteristic, "00002a25")) {                          // serial number
+        char serial[16];
+        std::snprintf(serial, sizeof serial, "SIM%04d", index);
+        value = serial;
+    }
+    return std::vector<uint8_t>(value.begin(), value.end());
+}
+
+void SimulatedMetaWearTransport::write(const std::string& /*service*/,
+                                       const std::string& /*characteristic*/,
+                                       const uint8_t* data, size_t size) {
+    if (size < 2) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handleCommand(data, size);
+    }
+    wake.notify_one();
+}
+
+void SimulatedMetaWearTransport::notify(const std::string& /*service*/,
+                                        const std::string& /*characteristic*/,
+                                        NotifyCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    notifyCallback = std::move(callback);
+}
+
+// ---------------------------------------------------------------------------
+// Command handling
+// ---------------------------------------------------------------------------
+
+void SimulatedMetaWearTransport::handleCommand(const uint8_t* data, size_t size) {
+    const uint8_t module = data[0];
+    const uint8_t reg    = data[1];
+
+    // Module discovery.
+    if (reg == kInfoRegister) {
+        std::vector<uint8_t> response = { module, kInfoRegister };
+        for (const auto& info : kModules)
+            if (info.id == module)
+                response.insert(response.end(), info.bytes, info.bytes + info.length);
+        pending.push_back(std::move(response));
+        return;
+    }
+
+    // Register reads: echo the last written value, or a plausible default.
+    if (reg & kReadBit) {
+        const uint8_t plain = reg & static_cast<uint8_t>(~kReadBit);
+        std::vector<uint8_t> response = { module, reg };
+        auto it = registers.find(static_cast<uint16_t>(module << 8 | plain));
+        if (it != registers.end())
+            response.insert(response.end(), it->second.begin(), it->second.end());
+        else if (module == kModuleSettings && plain == kSettingsBattery)
+            response.insert(response.end(), { 99, 0x68, 0x10 });   // 99 %, 4200 mV
+        pending.push_back(std::move(response));
+        return;
+    }
+
+    // Data processors: answer each creation with a fresh id.
+    if (module == kModuleProcessor) {
+        if (reg == kProcessorAdd && size >= 5) {
+            const uint8_t id = nextProcessorId++;
+            processors[id] = Processor{ data[2], data[3], data[4] };
+            pending.push_back({ kModuleProcessor, kProcessorAdd, id });
+        } else if (reg == kProcessorRemove && size >= 3) {
+            processors.erase(data[2]);
+        }
+        return;
+    }
+
+    // Register writes.
+    registers[static_cast<uint16_t>(module << 8 | reg)].assign(data + 2, data + size);
+
+    if (module == kModuleFusion) {
+        if (reg == kFusionEnable && size >= 3) {
+            fusionRunning = data[2] != 0;
+        } else if (reg == kFusionOutput && size >= 4) {
+            fusionOutputMask = static_cast<uint8_t>((fusionOutputMask | data[2]) & ~data[3]);
+        }
+    } else if (module == kModuleAcc || module == kModuleGyro) {
+        RawImu& imu = module == kModuleAcc ? rawAcc : rawGyro;
+        if (reg == kImuPowerMode && size >= 3) {
+            const bool wasRunning = imu.running;
+            imu.running = data[2] != 0;
+            if (imu.running && !wasRunning)
+                imu.nextPacket = std::chrono::steady_clock::now();
+        } else if (reg == kImuConfig) {
+            configureRawImu(imu, data + 2, size - 2);
+        }
+    }
+}
+
+void SimulatedMetaWearTransport::configureRawImu(RawImu& imu, const uint8_t* payload, size_t size) {
+    if (size < 2)
+        return;
+    imu.odrHz = boschOdrHz(payload[0]);
+    if (imu.module == kModuleAcc) {
+        // BMI160 range codes: 3 = 2 g, 5 = 4 g, 8 = 8 g, 12 = 16 g.
+        float g = 2.0f;
+        switch (payload[1] & 0x0f) {
+            case 0x5: g = 4.0f;  break;
+            case 0x8: g = 8.0f;  break;
+            case 0xc: g = 16.0f; break;
+            default: break;
+        }
+        imu.lsbPerUnit = 32768.0f / g;
+    } else {
+        // Range code 0..4 = 2000, 1000, 500, 250, 125 deg/s.
+        imu.lsbPerUnit = 16.4f * static_cast<float>(1 << std::min<int>(payload[1] & 0x07, 4));
+    }
+}
+
+void SimulatedMetaWearTransport::queuePackedFrame(RawImu& imu, double t) {
+    std::vector<uint8_t> packet = { imu.module, imu.packedRegister };
+    for (int k = 0; k < kPackedSamples; ++k) {
+        const float phase = static_cast<float>(t + index * 0.37 + k / imu.odrHz);
+        float v[3];
+        if (imu.module == kModuleAcc) {
+            v[0] = 0.5f * std::sin(20.0f * phase);   // g
+            v[1] = 0.5f * std::cos(20.0f * phase);
+            v[2] = 1.0f;
+        } else {
+            v[0] = 200.0f * std::cos(5.0f * phase);  // deg/s
+            v[1] = 0.0f;
+            v[2] = -200.0f * std::sin(5.0f * phase);
+        }
+        for (float f : v) {
+            const auto raw = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, f * imu.lsbPerUnit)));
+            packet.push_back(static_cast<uint8_t>(raw & 0xff));
+            packet.push_back(static_cast<uint8_t>((raw >> 8) & 0xff));
+        }
+    }
+    pending.push_back(std::move(packet));
+}
+
+void SimulatedMetaWearTransport::queueFusionFrame(double t) {
+    const float phase   = static_cast<float>(t + index * 0.37);
+    const float heading = std::fmod(30.0f * phase + 360.0f, 360.0f);
+    const float pitch   = 20.0f * std::sin(phase);
+    const float roll    = 10.0f * std::cos(phase);
+
+    // Quaternion for the same heading/pitch/roll (ZYX order).
+    const float d2r = 3.14159265f / 180.0f;
+    const float cy = std::cos(heading * d2r * 0.5f), sy = std::sin(heading * d2r * 0.5f);
+    const float cp = std::cos(pitch   * d2r * 0.5f), sp = std::sin(pitch   * d2r * 0.5f);
+    const float cr = std::cos(roll    * d2r * 0.5f), sr = std::sin(roll    * d2r * 0.5f);
+
+    for (uint8_t output = 0; output < 8; ++output) {
+        if (!(fusionOutputMask & (1u << output)))
+            continue;
+
+        std::vector<uint8_t> packet = { kModuleFusion, static_cast<uint8_t>(kFusionFirstData + output) };
+        switch (output) {
+            case 0:  // corrected acc (mg) + accuracy
+                appendFloats(packet, { 50.0f * std::sin(3.0f * phase), 50.0f * std::cos(3.0f * phase), 1000.0f });
+                packet.push_back(3);
+                break;
+            case 1:  // corrected gyro (dps) + accuracy
+                appendFloats(packet, { 30.0f * std::cos(phase), 0.0f, -30.0f * std::sin(phase) });
+                packet.push_back(3);
+                break;
+            case 2:  // corrected mag (uT) + accuracy
+                appendFloats(packet, { 25.0f, -12.0f, 48.0f });
+                packet.push_back(3);
+                break;
+            case 3:  // quaternion
+                appendFloats(packet, { cr * cp * cy + sr * sp * sy,
+                                       sr * cp * cy - cr * sp * sy,
+                                       cr * sp * cy + sr * cp * sy,
+                                       cr * cp * sy - sr * sp * cy });
+                break;
+            case 4:  // Euler angles
+                appendFloats(packet, { heading, pitch, roll, heading });
+                break;
+            case 5:  // gravity (g)
+                appendFloats(packet, { 0.0f, 0.0f, 1.0f });
+                break;
+            case 6:  // linear acc (g)
+                appendFloats(packet, { 0.05f * std::sin(3.0f * phase), 0.05f * std::cos(3.0f * phase), 0.0f });
+                break;
+            default:
+                continue;
+        }
+        queueProcessorOutputs(packet[0], packet[1], kNoProcessor, packet.data() + 2, packet.size() - 2);
+        pending.push_back(std::move(packet));
+    }
+}
+
+// Data processors pass their input through unchanged; only the last
+// processor of each chain notifies.
+void SimulatedMetaWearTransport::queueProcessorOutputs(uint8_t module, uint8_t reg, uint8_t id,
+                                                       const uint8_t* payload, size_t size) {
+    for (const auto& [processorId, source] : processors) {
+        if (source.module != module || source.reg != reg || (module == kModuleProcessor && source.id != id))
+            continue;
+        const bool hasNext = std::any_of(processors.begin(), processors.end(), [&](const auto& entry) {
+            return entry.second.module == kModuleProcessor && entry.second.id == processorId;
+        });
+        if (hasNext) {
+            queueProcessorOutputs(kModuleProcessor, kProcessorNotify, processorId, payload, size);
+        } else {
+            std::vector<uint8_t> packet = { kModuleProcessor, kProcessorNotify, processorId };
+            packet.insert(packet.end(), payload, payload + size);
+            pending.push_back(std::move(packet));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Worker: delivers responses and emits fusion data at `rateHz`, raw IMU
+// packets at each module's output data rate
+// ---------------------------------------------------------------------------
+
+void SimulatedMetaWearTransport::run() {
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / rateHz));
+    auto nextFrame = std::chrono::steady_clock::now() + period;
+
+    std::deque<std::vector<uint8_t>> outgoing;
+    NotifyCallback callback;
+
+    while (running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto wakeAt = nextFrame;
+            for (const RawImu* imu : { &rawAcc, &rawGyro })
+                if (imu->running)
+                    wakeAt = std::min(wakeAt, imu->nextPacket);
+            wake.wait_until(lock, wakeAt, [this] { return !pending.empty() || !running.load(); });
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= nextFrame) {
+                if (fusionRunning)
+                    queueFusionFrame(std::chrono::duration<double>(now - start).count());
+                nextFrame += period;
+                if (nextFrame < now)   // fell behind; do not burst to catch up
+                    nextFrame = now + period;
+            }
+
+            for (RawImu* imu : { &rawAcc, &rawGyro }) {
+                if (!imu->running || now < imu->nextPacket)
+                    continue;
+                queuePackedFrame(*imu, std::chrono::duration<double>(now - start).count());
+                const auto packetPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(kPackedSamples / imu->odrHz));
+                imu->nextPacket += packetPeriod;
+                if (imu->nextPacket < now)
+                    imu->nextPacket = now + packetPeriod;
+            }
+
+            outgoing.swap(pending);
+            callback = notifyCallback;
+        }
+
+        // Deliver outside the lock: the SDK may write back from the callback.
+        for (const auto& packet : outgoing)
+            if (callback)
+                callback(packet.data(), packet.size());
+        outgoing.clear();
+    }
+}
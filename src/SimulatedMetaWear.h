@@ -0,0 +1,85 @@
+#pragma once
+
+#include "BleTransport.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Simulated MetaMotion R board for load testing without hardware.
+//
+// Speaks enough of the MetaWear GATT protocol for the SDK's init handshake
+// (device information reads and module discovery), echoes configuration
+// registers back on read, and, once sensor fusion is started, emits fusion
+// notification packets for every enabled output at `rateHz`. When the
+// accelerometer or gyro is started directly (raw IMU mode) it emits their
+// packed data packets at the configured output data rate instead. Data
+// processors are created on request and pass their input through. Responses
+// and data are delivered from a per-board worker thread, like a real BLE stack.
+class SimulatedMetaWearTransport : public BleTransport {
+public:
+    SimulatedMetaWearTransport(int indexIn, double rateHzIn);
+    ~SimulatedMetaWearTransport() override;
+
+    std::string address() override;
+    void connect() override;
+    void disconnect() override;
+    bool isConnected() override { return connected.load(); }
+
+    std::vector<uint8_t> read(const std::string& service,
+                              const std::string& characteristic) override;
+    void write(const std::string& service, const std::string& characteristic,
+               const uint8_t* data, size_t size) override;
+    void notify(const std::string& service, const std::string& characteristic,
+                NotifyCallback callback) override;
+
+private:
+    void run();
+    void handleCommand(const uint8_t* data, size_t size);   // called with `mutex` held
+    void queueFusionFrame(double t);                         // called with `mutex` held
+    void queueProcessorOutputs(uint8_t module, uint8_t reg, uint8_t id,
+                               const uint8_t* payload, size_t size);   // called with `mutex` held
+
+    // Raw accelerometer / gyro module state, decoded from register writes.
+    struct RawImu {
+        uint8_t module;
+        uint8_t packedRegister;
+        bool    running   = false;
+        double  odrHz     = 100.0;
+        float   lsbPerUnit = 1.0f;                           // LSB per g or per deg/s
+        std::chrono::steady_clock::time_point nextPacket;
+    };
+    void configureRawImu(RawImu& imu, const uint8_t* payload, size_t size);   // called with `mutex` held
+    void queuePackedFrame(RawImu& imu, double t);                           // called with `mutex` held
+
+    const int    index;
+    const double rateHz;
+
+    std::atomic<bool> connected{false};
+    std::atomic<bool> running{false};
+    std::thread       worker;
+
+    std::mutex                        mutex;
+    std::condition_variable           wake;
+    std::deque<std::vector<uint8_t>>  pending;       // notifications not yet delivered
+    std::map<uint16_t, std::vector<uint8_t>> registers;  // last write per (module << 8 | register)
+    NotifyCallback                    notifyCallback;
+    bool                              fusionRunning    = false;
+    uint8_t                           fusionOutputMask = 0;
+    // Data processors by id, with the signal each reads from.
+    struct Processor {
+        uint8_t module;
+        uint8_t reg;
+        uint8_t id;   // source processor id, if module is the data processor
+    };
+    static constexpr uint8_t          kNoProcessor = 0xff;
+    std::map<uint8_t, Processor>      processors;
+    uint8_t                           nextProcessorId  = 0;
+    RawImu                            rawAcc;
+    RawImu                            rawGyro;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// Bounded, lock-free single-producer/single-consumer ring buffer.
+//
+// The producer (a MetaWear data callback on the BLE thread) calls push(),
+// the consumer (the OSC streaming thread) calls pop(). Neither side ever
+// blocks or allocates; when the ring is full the newest item is rejected.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity = Capacity;
+
+    // Returns false (and drops the item) if the queue is full.
+    bool push(const T& item) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity)
+            return false;
+        slots_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty.
+    bool pop(T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+        item = slots_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    // Consumer side only: discard everything currently queued.
+    void clear() {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    // Keep producer and consumer indices on separate cache lines.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::array<T, Capacity> slots_{};
+};